@@ -0,0 +1,222 @@
+#include "clusterDag.h"
+#include "simplification.h"
+#include "meshlet.h"
+#include "parallel.h"
+#include <atomic>
+#include <cfloat>
+#include <climits>
+#include <unordered_map>
+
+// local triangle indices of a cluster are bytes
+static const unsigned int MAX_CLUSTER_VERTICES = 255;
+// a level keeping more clusters than this share of the one below stops the build
+static const float MIN_REDUCTION = 0.95f;
+static const unsigned int SHARED = UINT_MAX - 1;
+
+/*
+ * Splitting triangles into clusters with the meshlet builder
+ * The builder closes a meshlet when nothing adjacent is left, so the small meshlets of a
+ * fragmented group are merged with the following ones up to max_triangles
+ * vertices and indices are local, global maps a local vertex to ClusterDag::vertices
+ */
+static vector<DagCluster> split_clusters(const vector<Vertex> & vertices, const vector<unsigned int> & global,
+                                         const vector<unsigned int> & indices, unsigned int max_triangles) {
+    MeshletData data = build_meshlets(vertices, indices, MAX_CLUSTER_VERTICES, max_triangles);
+    vector<DagCluster> clusters;
+    vector<glm::vec3> positions;
+    for (unsigned int i = 0; i < data.meshlets.size(); i++) {
+        const Meshlet & m = data.meshlets[i];
+        if (clusters.empty() || clusters.back().indices.size() / 3 + m.triangle_count > max_triangles) {
+            clusters.emplace_back();
+            positions.clear();
+        }
+        DagCluster & c = clusters.back();
+        for (unsigned int t = 0; t < m.triangle_count * 3; t++) {
+            unsigned int local = data.meshlet_vertices[m.vertex_offset + data.meshlet_triangles[m.triangle_offset * 3 + t]];
+            c.indices.push_back(global.empty() ? local : global[local]);
+            positions.push_back(vertices[local].Position);
+        }
+
+        // sphere around the box center
+        glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+        for (glm::vec3 & p : positions) {
+            min = glm::min(min, p);
+            max = glm::max(max, p);
+        }
+        c.center = (min + max) * 0.5f;
+        c.radius = 0.0f;
+        for (glm::vec3 & p : positions)
+            c.radius = glm::max(c.radius, glm::length(p - c.center));
+        c.error = 0.0f;
+        c.parent_error = FLT_MAX;
+        c.level = 0;
+    }
+    return clusters;
+}
+
+/*
+ * Greedy grouping, a group grows by the ungrouped cluster sharing the most vertices with it
+ * Clusters come out of the meshlet builder in a spatially coherent order, which seeds the groups
+ */
+static vector<vector<unsigned int>> group_clusters(const ClusterDag & dag, const vector<unsigned int> & level, unsigned int group_size) {
+    // clusters of each vertex
+    vector<vector<unsigned int>> vertex_clusters(dag.vertices.size());
+    for (unsigned int i = 0; i < level.size(); i++) {
+        for (unsigned int v : dag.clusters[level[i]].indices) {
+            vector<unsigned int> & list = vertex_clusters[v];
+            if (list.empty() || list.back() != i)
+                list.push_back(i);
+        }
+    }
+    // shared vertex count with each neighbouring cluster
+    vector<unordered_map<unsigned int, unsigned int>> neighbours(level.size());
+    for (vector<unsigned int> & list : vertex_clusters) {
+        for (unsigned int a : list)
+            for (unsigned int b : list)
+                if (a != b) neighbours[a][b]++;
+    }
+
+    vector<vector<unsigned int>> groups;
+    vector<unsigned int> group_of(level.size(), UINT_MAX);
+    for (unsigned int seed = 0; seed < level.size(); seed++) {
+        if (group_of[seed] != UINT_MAX) continue;
+        unsigned int g = groups.size();
+        vector<unsigned int> group {seed};
+        group_of[seed] = g;
+        unordered_map<unsigned int, unsigned int> weight;
+        while (group.size() < group_size) {
+            for (auto & n : neighbours[group.back()])
+                if (group_of[n.first] == UINT_MAX) weight[n.first] += n.second;
+            unsigned int best = UINT_MAX, best_weight = 0;
+            for (auto & w : weight) {
+                if (group_of[w.first] == UINT_MAX && (w.second > best_weight || (w.second == best_weight && w.first < best))) {
+                    best = w.first;
+                    best_weight = w.second;
+                }
+            }
+            if (best == UINT_MAX) break;
+            group.push_back(best);
+            group_of[best] = g;
+        }
+        groups.push_back(group);
+    }
+
+    // a group left with few clusters is mostly border, it joins the neighbour group sharing the most
+    for (unsigned int g = 0; g < groups.size(); g++) {
+        if (groups[g].empty() || groups[g].size() * 2 > group_size) continue;
+        unordered_map<unsigned int, unsigned int> weight;
+        for (unsigned int c : groups[g])
+            for (auto & n : neighbours[c])
+                if (group_of[n.first] != g) weight[group_of[n.first]] += n.second;
+        unsigned int best = UINT_MAX, best_weight = 0;
+        for (auto & w : weight) {
+            if (w.second > best_weight || (w.second == best_weight && w.first < best)) {
+                best = w.first;
+                best_weight = w.second;
+            }
+        }
+        if (best == UINT_MAX) continue;
+        for (unsigned int c : groups[g]) {
+            group_of[c] = best;
+            groups[best].push_back(c);
+        }
+        groups[g].clear();
+    }
+
+    vector<vector<unsigned int>> result;
+    for (vector<unsigned int> & group : groups) {
+        if (group.empty()) continue;
+        for (unsigned int & c : group)
+            c = level[c];
+        result.push_back(group);
+    }
+    return result;
+}
+
+/*
+ * Building the DAG level by level
+ * Every group of neighbouring clusters is merged, decimated to half its vertices with the vertices
+ * it shares with other groups locked, and split into new clusters, so neighbouring groups still
+ * match along their borders. Groups are independent and run in parallel.
+ */
+ClusterDag build_cluster_dag(const vector<Vertex> & vertices, const vector<unsigned int> & indices,
+                             unsigned int max_triangles, unsigned int group_size) {
+    ClusterDag dag;
+    dag.vertices = vertices;
+
+    vector<unsigned int> level_clusters;
+    for (DagCluster & c : split_clusters(dag.vertices, vector<unsigned int>(), indices, max_triangles)) {
+        level_clusters.push_back(dag.clusters.size());
+        dag.clusters.push_back(std::move(c));
+    }
+
+    for (unsigned int level = 1; level_clusters.size() > 1; level++) {
+        vector<vector<unsigned int>> groups = group_clusters(dag, level_clusters, group_size);
+
+        // the group of each vertex, SHARED when several groups use it
+        vector<unsigned int> vertex_group(dag.vertices.size(), UINT_MAX);
+        for (unsigned int g = 0; g < groups.size(); g++) {
+            for (unsigned int c : groups[g]) {
+                for (unsigned int v : dag.clusters[c].indices) {
+                    if (vertex_group[v] == UINT_MAX) vertex_group[v] = g;
+                    else if (vertex_group[v] != g) vertex_group[v] = SHARED;
+                }
+            }
+        }
+
+        vector<vector<DagCluster>> results(groups.size());
+        vector<float> group_error(groups.size());
+        atomic<size_t> next(0);
+        parallel_run(thread_count(groups.size(), 1), [&](unsigned int) {
+            for (size_t g = next++; g < groups.size(); g = next++) {
+                // merge the group into a local mesh
+                MeshData group;
+                vector<unsigned int> global;
+                unordered_map<unsigned int, unsigned int> local;
+                float error = 0.0f;
+                for (unsigned int c : groups[g]) {
+                    error = glm::max(error, dag.clusters[c].error);
+                    for (unsigned int v : dag.clusters[c].indices) {
+                        auto it = local.find(v);
+                        if (it == local.end()) {
+                            it = local.insert(pair<unsigned int, unsigned int>{v, global.size()}).first;
+                            global.push_back(v);
+                            group.vertices.push_back(dag.vertices[v]);
+                        }
+                        group.indices.push_back(it->second);
+                    }
+                }
+
+                MeshSimple ms(group);
+                for (unsigned int i = 0; i < global.size(); i++)
+                    if (vertex_group[global[i]] == SHARED) ms.lock(i);
+                ms.decimate(0.5f);
+
+                // errors never decrease towards the root
+                group_error[g] = glm::max(error, ms.error());
+                results[g] = split_clusters(group.vertices, global, ms.out_faces(), max_triangles);
+            }
+        });
+
+        vector<unsigned int> next_level;
+        for (unsigned int g = 0; g < groups.size(); g++) {
+            for (unsigned int c : groups[g])
+                dag.clusters[c].parent_error = group_error[g];
+            for (DagCluster & c : results[g]) {
+                c.error = group_error[g];
+                c.level = level;
+                c.children = groups[g];
+                next_level.push_back(dag.clusters.size());
+                dag.clusters.push_back(std::move(c));
+            }
+        }
+
+        bool stalled = next_level.size() > level_clusters.size() * MIN_REDUCTION;
+        level_clusters.swap(next_level);
+        // locked borders keep the groups from shrinking any further
+        if (stalled) break;
+    }
+
+    dag.roots = level_clusters;
+    return dag;
+}
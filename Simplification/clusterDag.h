@@ -0,0 +1,37 @@
+#ifndef SIMPLIFICATION_CLUSTERDAG_H
+#define SIMPLIFICATION_CLUSTERDAG_H
+
+#include "model/meshData.h"
+
+struct DagCluster {
+    // triangles, indices into ClusterDag::vertices
+    vector<unsigned int> indices;
+    // bounding sphere
+    glm::vec3 center;
+    float radius;
+    // quadric error of the simplification that produced the cluster, 0 on the finest level
+    float error;
+    // error of the group simplified from the cluster, FLT_MAX for the roots
+    float parent_error;
+    // 0 for the finest level
+    unsigned int level;
+    // clusters of the group the cluster was simplified from
+    vector<unsigned int> children;
+};
+
+/*
+ * Cluster LOD hierarchy
+ * At runtime a cluster is drawn when its own error is acceptable and its parent error is not
+ */
+struct ClusterDag {
+    // vertices of every level, simplification only removes vertices so they are shared
+    vector<Vertex> vertices;
+    vector<DagCluster> clusters;
+    vector<unsigned int> roots;
+};
+
+// clusters of at most max_triangles triangles, simplified in groups of group_size neighbouring clusters
+ClusterDag build_cluster_dag(const vector<Vertex> & vertices, const vector<unsigned int> & indices,
+                             unsigned int max_triangles = 124, unsigned int group_size = 4);
+
+#endif //SIMPLIFICATION_CLUSTERDAG_H
@@ -0,0 +1,224 @@
+#include "glbWriter.h"
+#include "quantize.h"
+#include "model/textParse.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// glTF enums
+static const int GL_BYTE_TYPE = 5120, GL_UNSIGNED_SHORT_TYPE = 5123, GL_UNSIGNED_INT_TYPE = 5125, GL_FLOAT_TYPE = 5126;
+static const int GL_ARRAY_BUFFER_TARGET = 34962, GL_ELEMENT_ARRAY_BUFFER_TARGET = 34963;
+// buffer views start on this boundary inside the binary chunk, which itself starts on it in the file
+static const size_t GLB_ALIGNMENT = 16;
+
+static void append_float(string & json, float value) {
+    char buffer[16];
+    json.append(buffer, format_float(buffer, value));
+}
+
+static void append_uint(string & json, size_t value) {
+    json += to_string(value);
+}
+
+static void append_vec3(string & json, const float * v) {
+    json += '[';
+    for (int k = 0; k < 3; k++) {
+        if (k) json += ',';
+        append_float(json, v[k]);
+    }
+    json += ']';
+}
+
+static void align(vector<unsigned char> & bin) {
+    bin.resize((bin.size() + GLB_ALIGNMENT - 1) / GLB_ALIGNMENT * GLB_ALIGNMENT, 0);
+}
+
+static signed char snorm8(float v) {
+    return (signed char) lround(glm::clamp(v, -1.0f, 1.0f) * 127.0f);
+}
+
+bool write_glb(const char * path, const vector<MeshData> & lods, bool quantized) {
+    vector<unsigned char> bin;
+    string views, accessors, meshes, nodes;
+
+    for (size_t l = 0; l < lods.size(); l++) {
+        const MeshData & lod = lods[l];
+        size_t num_vertices = lod.vertices.size();
+        size_t view = l * 2, accessor = l * 4;
+
+        // interleaved vertex view
+        align(bin);
+        size_t vertex_offset = bin.size(), stride;
+        glm::vec3 pos_min(FLT_MAX), pos_max(-FLT_MAX);
+        bool unorm_uv = true;
+        glm::mat4 decode(1.0f);
+        if (quantized) {
+            for (const Vertex & v : lod.vertices)
+                if (glm::any(glm::lessThan(v.TexCoords, glm::vec2(0.0f))) ||
+                    glm::any(glm::greaterThan(v.TexCoords, glm::vec2(1.0f))))
+                    unorm_uv = false;
+            // ushort4 position, byte4 normal, ushort2 or float2 texture coords
+            stride = unorm_uv ? 16 : 20;
+            QuantizedMesh q = quantize(lod.vertices, vector<unsigned int>());
+            decode = q.decode;
+            bin.resize(vertex_offset + num_vertices * stride, 0);
+            for (size_t i = 0; i < num_vertices; i++) {
+                unsigned char * out = &bin[vertex_offset + i * stride];
+                memcpy(out, q.vertices[i].position, 6);
+                for (int k = 0; k < 3; k++) {
+                    pos_min[k] = min(pos_min[k], (float) q.vertices[i].position[k]);
+                    pos_max[k] = max(pos_max[k], (float) q.vertices[i].position[k]);
+                }
+                glm::vec3 n = lod.vertices[i].Normal;
+                float length = glm::length(n);
+                if (length > 0.0f) n /= length;
+                for (int k = 0; k < 3; k++)
+                    out[8 + k] = (unsigned char) snorm8(n[k]);
+                const glm::vec2 & uv = lod.vertices[i].TexCoords;
+                if (unorm_uv) {
+                    unsigned short t[2] = {(unsigned short) lround(uv.x * 65535.0f), (unsigned short) lround(uv.y * 65535.0f)};
+                    memcpy(out + 12, t, 4);
+                }
+                else
+                    memcpy(out + 12, &uv.x, 8);
+            }
+        }
+        else {
+            // Vertex as it is, position, normal and texture coords
+            stride = sizeof(Vertex);
+            bin.resize(vertex_offset + num_vertices * stride);
+            if (num_vertices)
+                memcpy(&bin[vertex_offset], lod.vertices.data(), num_vertices * stride);
+            for (const Vertex & v : lod.vertices) {
+                pos_min = glm::min(pos_min, v.Position);
+                pos_max = glm::max(pos_max, v.Position);
+            }
+        }
+        if (num_vertices == 0)
+            pos_min = pos_max = glm::vec3(0.0f);
+
+        // index view, 16 bit when every index fits
+        align(bin);
+        size_t index_offset = bin.size();
+        bool short_indices = num_vertices <= 65535;
+        size_t index_size = short_indices ? 2 : 4;
+        bin.resize(index_offset + lod.indices.size() * index_size);
+        if (short_indices) {
+            unsigned short * out = (unsigned short *) &bin[index_offset];
+            for (size_t i = 0; i < lod.indices.size(); i++)
+                out[i] = (unsigned short) lod.indices[i];
+        }
+        else if (!lod.indices.empty())
+            memcpy(&bin[index_offset], lod.indices.data(), lod.indices.size() * 4);
+
+        if (l) views += ',';
+        views += "{\"buffer\":0,\"byteOffset\":"; append_uint(views, vertex_offset);
+        views += ",\"byteLength\":"; append_uint(views, num_vertices * stride);
+        views += ",\"byteStride\":"; append_uint(views, stride);
+        views += ",\"target\":"; append_uint(views, GL_ARRAY_BUFFER_TARGET);
+        views += "},{\"buffer\":0,\"byteOffset\":"; append_uint(views, index_offset);
+        views += ",\"byteLength\":"; append_uint(views, lod.indices.size() * index_size);
+        views += ",\"target\":"; append_uint(views, GL_ELEMENT_ARRAY_BUFFER_TARGET);
+        views += '}';
+
+        struct AccessorInfo { size_t offset; int type; bool normalized; const char * shape; };
+        AccessorInfo attributes[3];
+        if (quantized) {
+            attributes[0] = {0, GL_UNSIGNED_SHORT_TYPE, true, "VEC3"};
+            attributes[1] = {8, GL_BYTE_TYPE, true, "VEC3"};
+            attributes[2] = unorm_uv ? AccessorInfo{12, GL_UNSIGNED_SHORT_TYPE, true, "VEC2"}
+                                     : AccessorInfo{12, GL_FLOAT_TYPE, false, "VEC2"};
+        }
+        else {
+            attributes[0] = {0, GL_FLOAT_TYPE, false, "VEC3"};
+            attributes[1] = {12, GL_FLOAT_TYPE, false, "VEC3"};
+            attributes[2] = {24, GL_FLOAT_TYPE, false, "VEC2"};
+        }
+        if (l) accessors += ',';
+        for (int a = 0; a < 3; a++) {
+            if (a) accessors += ',';
+            accessors += "{\"bufferView\":"; append_uint(accessors, view);
+            accessors += ",\"byteOffset\":"; append_uint(accessors, attributes[a].offset);
+            accessors += ",\"componentType\":"; append_uint(accessors, attributes[a].type);
+            if (attributes[a].normalized) accessors += ",\"normalized\":true";
+            accessors += ",\"count\":"; append_uint(accessors, num_vertices);
+            accessors += ",\"type\":\""; accessors += attributes[a].shape; accessors += '"';
+            if (a == 0) {
+                accessors += ",\"min\":"; append_vec3(accessors, &pos_min.x);
+                accessors += ",\"max\":"; append_vec3(accessors, &pos_max.x);
+            }
+            accessors += '}';
+        }
+        accessors += ",{\"bufferView\":"; append_uint(accessors, view + 1);
+        accessors += ",\"componentType\":";
+        append_uint(accessors, short_indices ? GL_UNSIGNED_SHORT_TYPE : GL_UNSIGNED_INT_TYPE);
+        accessors += ",\"count\":"; append_uint(accessors, lod.indices.size());
+        accessors += ",\"type\":\"SCALAR\"}";
+
+        if (l) meshes += ',';
+        meshes += "{\"name\":\"LOD"; append_uint(meshes, l);
+        meshes += "\",\"primitives\":[{\"attributes\":{\"POSITION\":"; append_uint(meshes, accessor);
+        meshes += ",\"NORMAL\":"; append_uint(meshes, accessor + 1);
+        meshes += ",\"TEXCOORD_0\":"; append_uint(meshes, accessor + 2);
+        meshes += "},\"indices\":"; append_uint(meshes, accessor + 3);
+        meshes += ",\"mode\":4}]}";
+
+        if (l) nodes += ',';
+        nodes += "{\"name\":\"LOD"; append_uint(nodes, l);
+        nodes += "\",\"mesh\":"; append_uint(nodes, l);
+        if (quantized) {
+            nodes += ",\"matrix\":[";
+            const float * m = glm::value_ptr(decode);
+            for (int k = 0; k < 16; k++) {
+                if (k) nodes += ',';
+                append_float(nodes, m[k]);
+            }
+            nodes += ']';
+        }
+        if (l == 0 && lods.size() > 1) {
+            nodes += ",\"extensions\":{\"MSFT_lod\":{\"ids\":[";
+            for (size_t c = 1; c < lods.size(); c++) {
+                if (c > 1) nodes += ',';
+                append_uint(nodes, c);
+            }
+            nodes += "]}}";
+        }
+        nodes += '}';
+    }
+    align(bin);
+
+    string extensions;
+    if (lods.size() > 1) extensions += "\"MSFT_lod\"";
+    if (quantized) extensions += string(extensions.empty() ? "" : ",") + "\"KHR_mesh_quantization\"";
+    string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"Simplification\"}";
+    if (!extensions.empty()) json += ",\"extensionsUsed\":[" + extensions + "]";
+    if (quantized) json += ",\"extensionsRequired\":[\"KHR_mesh_quantization\"]";
+    json += ",\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[" + nodes + "]";
+    json += ",\"meshes\":[" + meshes + "],\"accessors\":[" + accessors + "],\"bufferViews\":[" + views + "]";
+    json += ",\"buffers\":[{\"byteLength\":" + to_string(bin.size()) + "}]}";
+    // pad with spaces so the binary chunk data starts aligned: 12 header, 8 + json, 8 bin chunk header
+    while ((12 + 8 + json.size() + 8) % GLB_ALIGNMENT != 0)
+        json += ' ';
+
+    uint32_t json_length = (uint32_t) json.size(), bin_length = (uint32_t) bin.size();
+    uint32_t header[3] = {0x46546C67u, 2, (uint32_t) (12 + 8 + json_length + 8 + bin_length)};
+    uint32_t json_chunk[2] = {json_length, 0x4E4F534Au}, bin_chunk[2] = {bin_length, 0x004E4942u};
+
+    FILE * file = fopen(path, "wb");
+    if (!file) {
+        cout << "ERROR::GLBWRITER::FILE_NOT_SUCCESFULLY_WRITTEN" << endl;
+        return false;
+    }
+    bool ok = fwrite(header, 4, 3, file) == 3 && fwrite(json_chunk, 4, 2, file) == 2 &&
+              fwrite(json.data(), 1, json.size(), file) == json.size() && fwrite(bin_chunk, 4, 2, file) == 2 &&
+              fwrite(bin.data(), 1, bin.size(), file) == bin.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+        cout << "ERROR::GLBWRITER::FILE_NOT_SUCCESFULLY_WRITTEN" << endl;
+    return ok;
+}
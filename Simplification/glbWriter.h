@@ -0,0 +1,17 @@
+#ifndef SIMPLIFICATION_GLBWRITER_H
+#define SIMPLIFICATION_GLBWRITER_H
+
+#include "model/meshData.h"
+
+/*
+ * Writes LODs, finest first, into one binary glTF file
+ * Every LOD is a mesh on its own node, node 0 lists the coarser ones through MSFT_lod.
+ * All data lives in one buffer, a 16 byte aligned interleaved vertex view and an index view per LOD,
+ * indices are 16 bit when the LOD has few enough vertices.
+ * With quantized, attributes use KHR_mesh_quantization: unorm16 positions in the LOD bounding box
+ * decoded by the node matrix with a uniform scale, so the model space snorm8 normals stay right,
+ * unorm16 texture coords when they lie in [0, 1]
+ */
+bool write_glb(const char * path, const vector<MeshData> & lods, bool quantized = false);
+
+#endif //SIMPLIFICATION_GLBWRITER_H
@@ -114,9 +114,34 @@ glmEqual(GLfloat* u, GLfloat* v, GLfloat epsilon)
     return GL_FALSE;
 }
 
+/* glmWeldCell: grid cell of a coordinate for cells of size epsilon */
+static long long
+glmWeldCell(GLfloat f, GLfloat epsilon)
+{
+    return (long long)floor((double)f / epsilon);
+}
+
+/* glmWeldHash: bucket of a grid cell, mask is the table size - 1 */
+static GLuint
+glmWeldHash(long long x, long long y, long long z, GLuint mask)
+{
+    unsigned long long h;
+    
+    h = (unsigned long long)x * 73856093ULL;
+    h ^= (unsigned long long)y * 19349663ULL;
+    h ^= (unsigned long long)z * 83492791ULL;
+    h ^= h >> 31;
+    return (GLuint)(h & mask);
+}
+
 /* glmWeldVectors: eliminate (weld) vectors that are within an
  * epsilon of each other.
  *
+ * Kept vectors are bucketed in a hash of epsilon sized grid cells, so
+ * only the 27 cells around a vector are searched and the weld is linear
+ * in the number of vectors.  A vector welds to the earliest kept vector
+ * it matches.
+ *
  * vectors     - array of GLfloat[3]'s to be welded
  * numvectors - number of GLfloat[3]'s in vectors
  * epsilon     - maximum difference between vectors 
@@ -126,34 +151,66 @@ GLfloat*
 glmWeldVectors(GLfloat* vectors, GLuint* numvectors, GLfloat epsilon)
 {
     GLfloat* copies;
-    GLuint copied;
-    GLuint i, j;
+    GLuint* heads;
+    GLuint* next;
+    GLuint copied, size, mask, bucket, found, k;
+    GLuint i;
+    long long cx, cy, cz;
+    int dx, dy, dz;
+    GLfloat cellsize;
     
     copies = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (*numvectors + 1));
-    memcpy(copies, vectors, (sizeof(GLfloat) * 3 * (*numvectors + 1)));
-    
-    copied = 1;
+    next = (GLuint*)malloc(sizeof(GLuint) * (*numvectors + 1));
+    size = 1;
+    while (size < 2 * *numvectors)
+        size <<= 1;
+    mask = size - 1;
+    heads = (GLuint*)malloc(sizeof(GLuint) * size);
+    /* 0 is the empty chain, kept vectors are 1 based */
+    memset(heads, 0, sizeof(GLuint) * size);
+    cellsize = epsilon > 0 ? epsilon : 1.0;
+    copies[0] = vectors[0];
+    copies[1] = vectors[1];
+    copies[2] = vectors[2];
+    
+    copied = 0;
     for (i = 1; i <= *numvectors; i++) {
-        for (j = 1; j <= copied; j++) {
-            if (glmEqual(&vectors[3 * i], &copies[3 * j], epsilon)) {
-                goto duplicate;
-            }
-        }
+        cx = glmWeldCell(vectors[3 * i + 0], cellsize);
+        cy = glmWeldCell(vectors[3 * i + 1], cellsize);
+        cz = glmWeldCell(vectors[3 * i + 2], cellsize);
         
-        /* must not be any duplicates -- add to the copies array */
-        copies[3 * copied + 0] = vectors[3 * i + 0];
-        copies[3 * copied + 1] = vectors[3 * i + 1];
-        copies[3 * copied + 2] = vectors[3 * i + 2];
-        j = copied;             /* pass this along for below */
-        copied++;
+        found = 0;
+        for (dx = -1; dx <= 1; dx++)
+            for (dy = -1; dy <= 1; dy++)
+                for (dz = -1; dz <= 1; dz++) {
+                    bucket = glmWeldHash(cx + dx, cy + dy, cz + dz, mask);
+                    for (k = heads[bucket]; k; k = next[k]) {
+                        if ((!found || k < found) &&
+                            glmEqual(&vectors[3 * i], &copies[3 * k], epsilon))
+                            found = k;
+                    }
+                }
+        
+        if (!found) {
+            /* must not be any duplicates -- add to the copies array */
+            copied++;
+            copies[3 * copied + 0] = vectors[3 * i + 0];
+            copies[3 * copied + 1] = vectors[3 * i + 1];
+            copies[3 * copied + 2] = vectors[3 * i + 2];
+            bucket = glmWeldHash(cx, cy, cz, mask);
+            next[copied] = heads[bucket];
+            heads[bucket] = copied;
+            found = copied;
+        }
         
-duplicate:
         /* set the first component of this vector to point at the correct
         index into the new copies array */
-        vectors[3 * i + 0] = (GLfloat)j;
+        vectors[3 * i + 0] = (GLfloat)found;
     }
     
-    *numvectors = copied-1;
+    free(heads);
+    free(next);
+    *numvectors = copied;
     return copies;
 }
 
@@ -1729,7 +1786,7 @@ glmWeld(GLMmodel* model, GLfloat epsilon)
     
 #if 0
     printf("glmWeld(): %d redundant vertices.\n", 
-        model->numvertices - numvectors - 1);
+        model->numvertices - numvectors);
 #endif
     
     for (i = 0; i < model->numtriangles; i++) {
@@ -35,7 +35,9 @@ float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 // model
-Mesh * mp, * mr;
+MeshData * mp;
+Mesh * mr;
+MeshCache * cp;
 
 // lighting
 // glm::vec3 lightPos (1.2f, 1.0f, 2.0f);
@@ -96,10 +98,23 @@ int main()
     // Mesh ourModel = loadOBJ("/Users/fengyandeng/Desktop/Object/sphere0.obj");
     // Mesh ourModel = loadOBJ("/Users/fengyandeng/Desktop/Object/sphere0.obj"),
     //   mesh = loadOBJ("/Users/fengyandeng/Desktop/Object/sphere0.obj");
-    Mesh ourModel = loadOBJ("../resources/objects/AngelLucy/Alucy.obj", 0.01f),
-         mesh = loadOBJ("../resources/objects/AngelLucy/Alucy.obj", 0.01f);
+    // the source stays on the CPU, only the rendered copy is uploaded
+    // parsed once into a binary cache next to the model, later runs map the cache instead
+    const char * modelPath = "../resources/objects/AngelLucy/Alucy.obj";
+    const float modelScale = 0.01f;
+    string cachePath = string(modelPath) + ".cache";
+    {
+        MeshCache existing(cachePath.c_str());
+        if (!existing.matches(modelPath, modelScale))
+            write_mesh_cache(cachePath.c_str(), loadOBJ(modelPath, modelScale), modelPath, modelScale);
+    }
+    MeshCache cache(cachePath.c_str());
+    // the source for simplification is the cache when it is valid, mesh otherwise
+    MeshData mesh = cache.valid() ? MeshData() : loadOBJ(modelPath, modelScale);
+    Mesh ourModel(cache.valid() ? cache.data() : mesh);
     mp = &mesh;
     mr = &ourModel;
+    cp = cache.valid() ? &cache : nullptr;
 
     // draw in wireframe
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -193,9 +208,9 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(RIGHT, deltaTime);
 
     if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) {
-        MeshSimple ms(*mp);
+        MeshSimple ms = cp ? MeshSimple(*cp) : MeshSimple(*mp);
         ms.decimate(0.1);
-        *mr = ms.out();
+        *mr = ms.out_indexed();
     }
 
 }
@@ -235,14 +250,14 @@ void scroll_callback(GLFWwindow * window, double xoffset, double yoffset) {
 
 void key_callback(GLFWwindow * window, int key, int scancode, int action, int mods) {
     if (key == GLFW_KEY_T && action == GLFW_PRESS) {
-        MeshSimple ms(*mp);
+        MeshSimple ms = cp ? MeshSimple(*cp) : MeshSimple(*mp);
         ms.decimate(0.1);
-        *mr = ms.out();
+        *mr = ms.out_indexed();
     }
 
     else if (key == GLFW_KEY_C && action == GLFW_PRESS) {
-        MeshSimple ms(*mp);
+        MeshSimple ms = cp ? MeshSimple(*cp) : MeshSimple(*mp);
         ms.cluster(100);
-        *mr = ms.out();
+        *mr = ms.out_indexed();
     }
 }
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include "meshCache.h"
+#include "parallel.h"
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+static const char MESH_CACHE_MAGIC[8] = {'M', 'S', 'C', 'A', 'C', 'H', 'E', '\0'};
+
+// bytes every section should hold for the counts in the header
+static uint64_t section_size(const MeshCacheHeader & header, int s) {
+    switch (s) {
+        case CACHE_VERTICES: return header.vertex_count * sizeof(Vertex);
+        case CACHE_INDICES: return header.face_count * 3 * sizeof(unsigned int);
+        case CACHE_ADJACENCY_OFFSETS: return (header.vertex_count + 1) * sizeof(unsigned int);
+        case CACHE_ADJACENCY_FACES: return header.face_count * 3 * sizeof(unsigned int);
+        case CACHE_FACE_PLANES: return header.face_count * sizeof(glm::vec4);
+        case CACHE_QUADRICS: return header.vertex_count * sizeof(glm::mat4);
+        default: return 0;
+    }
+}
+
+// sub-second part of the modification time, a rewrite within the same second still changes it
+static uint32_t mtime_nsec(const struct stat & st) {
+#ifdef __APPLE__
+    return (uint32_t) st.st_mtimespec.tv_nsec;
+#else
+    return (uint32_t) st.st_mtim.tv_nsec;
+#endif
+}
+
+// true when fn(i) holds for every i in [0, count), checked in parallel
+template <typename F>
+static bool all_of_range(size_t count, F fn) {
+    vector<char> failed(max(1u, thread::hardware_concurrency()), 0);
+    parallel_for(count, [&](unsigned int t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end && !failed[t]; i++)
+            if (!fn(i)) failed[t] = 1;
+    });
+    return find(failed.begin(), failed.end(), 1) == failed.end();
+}
+
+MeshCache::MeshCache(const char * path) : file(path) {
+    if (!file.valid() || file.size() < sizeof(MeshCacheHeader))
+        return;
+    const MeshCacheHeader * h = (const MeshCacheHeader *) file.data();
+    if (memcmp(h->magic, MESH_CACHE_MAGIC, 8) != 0 || h->version != MESH_CACHE_VERSION)
+        return;
+    const unsigned int required = (1u << CACHE_VERTICES) | (1u << CACHE_INDICES);
+    if ((h->sections & required) != required)
+        return;
+    for (int s = 0; s < MESH_CACHE_SECTIONS; s++) {
+        if (!(h->sections & (1u << s))) continue;
+        if (h->offsets[s] % MESH_CACHE_ALIGNMENT != 0 || h->sizes[s] != section_size(*h, s) ||
+            h->offsets[s] > file.size() || h->sizes[s] > file.size() - h->offsets[s])
+            return;
+    }
+    header = h;
+
+    // a corrupt cache must not send MeshSimple or decimate out of bounds
+    size_t num_vertices = h->vertex_count, num_faces = h->face_count;
+    const unsigned int * face_indices = indices();
+    bool ok = all_of_range(num_faces * 3, [&](size_t i) { return face_indices[i] < num_vertices; });
+    if (ok && has_state()) {
+        const unsigned int * offsets = adjacency_offsets(), * faces = adjacency_faces();
+        ok = offsets[0] == 0 && offsets[num_vertices] == num_faces * 3 &&
+             all_of_range(num_vertices, [&](size_t v) { return offsets[v] <= offsets[v + 1]; }) &&
+             all_of_range(num_faces * 3, [&](size_t i) { return faces[i] < num_faces; });
+    }
+    if (!ok)
+        header = nullptr;
+}
+
+bool MeshCache::matches(const char * source_path, float scale) const {
+    struct stat st;
+    if (!valid() || stat(source_path, &st) != 0)
+        return false;
+    return header->source_size == (uint64_t) st.st_size && header->source_mtime == (uint64_t) st.st_mtime &&
+           header->source_mtime_nsec == mtime_nsec(st) && header->source_scale == scale;
+}
+
+bool MeshCache::has_state() const {
+    const unsigned int state = (1u << CACHE_ADJACENCY_OFFSETS) | (1u << CACHE_ADJACENCY_FACES) |
+                               (1u << CACHE_FACE_PLANES) | (1u << CACHE_QUADRICS);
+    return (header->sections & state) == state;
+}
+
+MeshData MeshCache::data() const {
+    MeshData mesh;
+    mesh.vertices.assign(vertices(), vertices() + vertex_count());
+    mesh.indices.assign(indices(), indices() + face_count() * 3);
+    return mesh;
+}
+
+bool write_mesh_cache(const char * path, const MeshData & mesh, const char * source_path, float scale, bool state) {
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_CACHE_MAGIC, 8);
+    header.version = MESH_CACHE_VERSION;
+    header.vertex_count = mesh.vertices.size();
+    header.face_count = mesh.indices.size() / 3;
+    struct stat st;
+    if (source_path && stat(source_path, &st) == 0) {
+        header.source_size = st.st_size;
+        header.source_mtime = st.st_mtime;
+        header.source_mtime_nsec = mtime_nsec(st);
+    }
+    header.source_scale = scale;
+
+    size_t num_vertices = mesh.vertices.size(), num_faces = mesh.indices.size() / 3;
+    vector<unsigned int> adjacency_offsets, adjacency_faces;
+    vector<glm::vec4> planes;
+    vector<glm::mat4> quadrics;
+    if (state) {
+        // connected faces in face order, the order MeshSimple builds them in
+        adjacency_offsets.assign(num_vertices + 1, 0);
+        for (size_t i = 0; i < num_faces * 3; i++)
+            adjacency_offsets[mesh.indices[i] + 1]++;
+        for (size_t v = 0; v < num_vertices; v++)
+            adjacency_offsets[v + 1] += adjacency_offsets[v];
+        adjacency_faces.resize(num_faces * 3);
+        vector<unsigned int> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+        for (size_t i = 0; i < num_faces * 3; i++)
+            adjacency_faces[fill[mesh.indices[i]]++] = (unsigned int) (i / 3);
+
+        // same plane and quadric as MeshSimple::init_quadric
+        planes.resize(num_faces);
+        quadrics.assign(num_vertices, glm::mat4(0.0f));
+        for (size_t f = 0; f < num_faces; f++) {
+            const unsigned int * face = &mesh.indices[f * 3];
+            glm::vec3 p0 = mesh.vertices[face[0]].Position;
+            glm::vec3 v0 = mesh.vertices[face[1]].Position - p0;
+            glm::vec3 v1 = mesh.vertices[face[2]].Position - mesh.vertices[face[1]].Position;
+            glm::vec3 n = glm::normalize(glm::cross(v0, v1));
+            float a = n.x, b = n.y, c = n.z;
+            float d = - (a * p0.x + b * p0.y + c * p0.z);
+            planes[f] = glm::vec4(a, b, c, d);
+            glm::mat4 Q = glm::mat4 {
+                a*a, a*b, a*c, a*d,
+                b*a, b*b, b*c, b*d,
+                c*a, c*b, c*c, c*d,
+                d*a, d*b, d*c, d*d
+            };
+            for (int j = 0; j < 3; j++)
+                quadrics[face[j]] = quadrics[face[j]] + Q;
+        }
+    }
+
+    const void * data[MESH_CACHE_SECTIONS] = {
+        mesh.vertices.data(), mesh.indices.data(), adjacency_offsets.data(),
+        adjacency_faces.data(), planes.data(), quadrics.data()
+    };
+    uint64_t offset = (sizeof(MeshCacheHeader) + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+    for (int s = 0; s < MESH_CACHE_SECTIONS; s++) {
+        if (!state && s >= CACHE_ADJACENCY_OFFSETS) continue;
+        header.sections |= 1u << s;
+        header.offsets[s] = offset;
+        header.sizes[s] = section_size(header, s);
+        offset = (offset + header.sizes[s] + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+    }
+
+    FILE * file = fopen(path, "wb");
+    if (!file) {
+        cout << "ERROR::MESHCACHE::FILE_NOT_SUCCESFULLY_WRITTEN" << endl;
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    uint64_t written = sizeof(header);
+    static const char padding[MESH_CACHE_ALIGNMENT] = {};
+    for (int s = 0; s < MESH_CACHE_SECTIONS && ok; s++) {
+        if (!(header.sections & (1u << s))) continue;
+        ok = fwrite(padding, 1, header.offsets[s] - written, file) == header.offsets[s] - written;
+        ok = ok && fwrite(data[s], 1, header.sizes[s], file) == header.sizes[s];
+        written = header.offsets[s] + header.sizes[s];
+    }
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+        cout << "ERROR::MESHCACHE::FILE_NOT_SUCCESFULLY_WRITTEN" << endl;
+    return ok;
+}
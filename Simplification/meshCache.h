@@ -0,0 +1,87 @@
+#ifndef SIMPLIFICATION_MESHCACHE_H
+#define SIMPLIFICATION_MESHCACHE_H
+
+#include "model/meshData.h"
+#include "model/mappedFile.h"
+#include <cstdint>
+
+/*
+ * Binary mesh cache, memory mapped and used in place
+ * A header followed by 64 byte aligned sections in native byte order. Besides the mesh,
+ * the optional sections hold the MeshSimple input state: per vertex connected faces in CSR form,
+ * face planes and vertex quadrics
+ */
+
+enum MeshCacheSection {
+    // Vertex[vertex_count]
+    CACHE_VERTICES,
+    // unsigned int[face_count * 3]
+    CACHE_INDICES,
+    // unsigned int[vertex_count + 1], faces of vertex v are adjacency_faces[offsets[v], offsets[v + 1])
+    CACHE_ADJACENCY_OFFSETS,
+    // unsigned int[face_count * 3]
+    CACHE_ADJACENCY_FACES,
+    // glm::vec4[face_count], unit normal and d of ax + by + cz + d = 0
+    CACHE_FACE_PLANES,
+    // glm::mat4[vertex_count], summed plane quadrics of the connected faces
+    CACHE_QUADRICS,
+    MESH_CACHE_SECTIONS
+};
+
+const unsigned int MESH_CACHE_VERSION = 2;
+const unsigned int MESH_CACHE_ALIGNMENT = 64;
+
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    // bit s set when section s is present
+    uint32_t sections;
+    uint64_t vertex_count, face_count;
+    // source file the cache was built from, to notice when it is stale, mtime in seconds and nanoseconds
+    uint64_t source_size, source_mtime;
+    float source_scale;
+    uint32_t source_mtime_nsec;
+    uint64_t offsets[MESH_CACHE_SECTIONS];
+    uint64_t sizes[MESH_CACHE_SECTIONS];
+};
+
+class MeshCache {
+public:
+    explicit MeshCache(const char * path);
+
+    // mapped, every section consistent with the counts and every index in range
+    bool valid() const { return header != nullptr; }
+    // built from this source file with this scale, and the file did not change since
+    bool matches(const char * source_path, float scale) const;
+    // adjacency, planes and quadrics are all present
+    bool has_state() const;
+
+    size_t vertex_count() const { return header->vertex_count; }
+    size_t face_count() const { return header->face_count; }
+    const Vertex * vertices() const { return section<Vertex>(CACHE_VERTICES); }
+    const unsigned int * indices() const { return section<unsigned int>(CACHE_INDICES); }
+    const unsigned int * adjacency_offsets() const { return section<unsigned int>(CACHE_ADJACENCY_OFFSETS); }
+    const unsigned int * adjacency_faces() const { return section<unsigned int>(CACHE_ADJACENCY_FACES); }
+    const glm::vec4 * face_planes() const { return section<glm::vec4>(CACHE_FACE_PLANES); }
+    const glm::mat4 * quadrics() const { return section<glm::mat4>(CACHE_QUADRICS); }
+
+    // copy of the mesh sections
+    MeshData data() const;
+
+private:
+    MappedFile file;
+    const MeshCacheHeader * header = nullptr;
+
+    template <typename T>
+    const T * section(MeshCacheSection s) const {
+        return header->sections & (1u << s) ? (const T *) (file.data() + header->offsets[s]) : nullptr;
+    }
+};
+
+/*
+ * Writes mesh and, with state, the MeshSimple input state to path
+ * source_path and scale are recorded so MeshCache::matches can tell when to rebuild
+ */
+bool write_mesh_cache(const char * path, const MeshData & mesh, const char * source_path, float scale, bool state = true);
+
+#endif //SIMPLIFICATION_MESHCACHE_H
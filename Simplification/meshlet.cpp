@@ -0,0 +1,187 @@
+#include "meshlet.h"
+#include <cfloat>
+#include <climits>
+#include <cmath>
+
+// cones wider than this (dot between axis and a normal) can never cull anything
+static const float MIN_CONE_DOT = 0.1f;
+
+static void meshlet_bounds(MeshletData & data, Meshlet & m) {
+    // sphere around the box center
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+    for (unsigned int i = 0; i < m.vertex_count; i++) {
+        glm::vec3 p = data.vertices[data.meshlet_vertices[m.vertex_offset + i]].Position;
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+    m.center = (min + max) * 0.5f;
+    m.radius = 0.0f;
+    for (unsigned int i = 0; i < m.vertex_count; i++)
+        m.radius = glm::max(m.radius, glm::length(data.vertices[data.meshlet_vertices[m.vertex_offset + i]].Position - m.center));
+
+    // cone around the average triangle normal
+    vector<glm::vec3> normals, corners;
+    glm::vec3 axis(0.0f);
+    for (unsigned int t = 0; t < m.triangle_count; t++) {
+        const unsigned char * tri = &data.meshlet_triangles[(m.triangle_offset + t) * 3];
+        glm::vec3 p0 = data.vertices[data.meshlet_vertices[m.vertex_offset + tri[0]]].Position;
+        glm::vec3 p1 = data.vertices[data.meshlet_vertices[m.vertex_offset + tri[1]]].Position;
+        glm::vec3 p2 = data.vertices[data.meshlet_vertices[m.vertex_offset + tri[2]]].Position;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p1);
+        float len = glm::length(normal);
+        if (len == 0.0f) continue;
+        normals.push_back(normal / len);
+        corners.push_back(p0);
+        axis += normal / len;
+    }
+    float len = glm::length(axis);
+    m.cone_axis = len > 0.0f ? axis / len : glm::vec3(0.0f, 0.0f, 1.0f);
+    float min_dot = len > 0.0f ? 1.0f : -1.0f;
+    for (glm::vec3 & n : normals)
+        min_dot = glm::min(min_dot, glm::dot(n, m.cone_axis));
+
+    m.cone_apex = m.center;
+    if (min_dot <= MIN_CONE_DOT) {
+        // degenerate cone, never culled
+        m.cone_cutoff = 1.0f;
+        return;
+    }
+    // move the apex back until it is behind every triangle plane
+    float max_t = 0.0f;
+    for (unsigned int i = 0; i < normals.size(); i++)
+        max_t = glm::max(max_t, glm::dot(m.center - corners[i], normals[i]) / glm::dot(m.cone_axis, normals[i]));
+    m.cone_apex = m.center - m.cone_axis * max_t;
+    m.cone_cutoff = sqrt(1.0f - min_dot * min_dot);
+}
+
+/*
+ * Greedy growth over the vertex - triangle adjacency
+ * The next triangle is the adjacent one adding the fewest new vertices, ties go to the one
+ * closest to the meshlet centroid, a full meshlet is seeded again next to the previous one
+ */
+MeshletData build_meshlets(vector<Vertex> vertices, const vector<unsigned int> & indices,
+                           unsigned int max_vertices, unsigned int max_triangles) {
+    MeshletData data;
+    data.vertices.swap(vertices);
+    size_t vertex_count = data.vertices.size(), face_count = indices.size() / 3;
+
+    // triangles of each vertex, the first remaining[v] entries are not emitted yet
+    vector<unsigned int> remaining(vertex_count, 0), offsets(vertex_count + 1, 0), adjacency(face_count * 3);
+    for (size_t i = 0; i < face_count * 3; i++)
+        remaining[indices[i]]++;
+    for (size_t v = 0; v < vertex_count; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < face_count * 3; i++)
+        adjacency[fill[indices[i]]++] = i / 3;
+
+    vector<glm::vec3> centroids(face_count);
+    for (size_t f = 0; f < face_count; f++)
+        centroids[f] = (data.vertices[indices[f * 3]].Position + data.vertices[indices[f * 3 + 1]].Position
+                        + data.vertices[indices[f * 3 + 2]].Position) / 3.0f;
+
+    // local index of a vertex in the current meshlet, UINT_MAX when absent
+    vector<unsigned int> local(vertex_count, UINT_MAX);
+    vector<char> emitted(face_count, 0);
+    size_t cursor = 0;
+
+    Meshlet current {};
+    glm::vec3 centroid_sum(0.0f);
+    // vertices of the meshlet just finished, where the next one is seeded
+    vector<unsigned int> previous;
+
+    auto new_vertices = [&](unsigned int f) {
+        unsigned int count = 0;
+        for (int k = 0; k < 3; k++)
+            if (local[indices[f * 3 + k]] == UINT_MAX) count++;
+        return count;
+    };
+
+    auto finish = [&]() {
+        if (current.triangle_count == 0) return;
+        meshlet_bounds(data, current);
+        data.meshlets.push_back(current);
+        previous.assign(data.meshlet_vertices.begin() + current.vertex_offset, data.meshlet_vertices.end());
+        for (unsigned int v : previous)
+            local[v] = UINT_MAX;
+        current = Meshlet {};
+        current.vertex_offset = (unsigned int) data.meshlet_vertices.size();
+        current.triangle_offset = (unsigned int) data.meshlet_triangles.size() / 3;
+        centroid_sum = glm::vec3(0.0f);
+    };
+
+    for (size_t emitted_count = 0; emitted_count < face_count; emitted_count++) {
+        unsigned int best = UINT_MAX, best_new = UINT_MAX;
+        float best_distance = FLT_MAX;
+
+        if (current.triangle_count > 0) {
+            glm::vec3 centroid = centroid_sum / float(current.triangle_count);
+            for (unsigned int i = 0; i < current.vertex_count; i++) {
+                unsigned int v = data.meshlet_vertices[current.vertex_offset + i];
+                for (unsigned int j = 0; j < remaining[v]; j++) {
+                    unsigned int f = adjacency[offsets[v] + j];
+                    unsigned int count = new_vertices(f);
+                    if (current.vertex_count + count > max_vertices) continue;
+                    float distance = glm::length(centroids[f] - centroid);
+                    if (count < best_new || (count == best_new && distance < best_distance)) {
+                        best = f;
+                        best_new = count;
+                        best_distance = distance;
+                    }
+                }
+            }
+            if (best == UINT_MAX || current.triangle_count == max_triangles) {
+                finish();
+                best = UINT_MAX;
+                // measured against the finished meshlet, the seed search starts over
+                best_distance = FLT_MAX;
+            }
+        }
+
+        if (best == UINT_MAX) {
+            // seed next to the previous meshlet, or at the first triangle left
+            glm::vec3 centroid(0.0f);
+            for (unsigned int v : previous)
+                centroid += data.vertices[v].Position;
+            if (!previous.empty()) centroid /= float(previous.size());
+            for (unsigned int v : previous) {
+                for (unsigned int j = 0; j < remaining[v]; j++) {
+                    unsigned int f = adjacency[offsets[v] + j];
+                    float distance = glm::length(centroids[f] - centroid);
+                    if (distance < best_distance) {
+                        best = f;
+                        best_distance = distance;
+                    }
+                }
+            }
+            if (best == UINT_MAX) {
+                while (emitted[cursor]) cursor++;
+                best = cursor;
+            }
+        }
+
+        // add the triangle
+        emitted[best] = 1;
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = indices[best * 3 + k];
+            if (local[v] == UINT_MAX) {
+                local[v] = current.vertex_count++;
+                data.meshlet_vertices.push_back(v);
+            }
+            data.meshlet_triangles.push_back((unsigned char) local[v]);
+
+            // detach the triangle from its vertex
+            unsigned int * list = &adjacency[offsets[v]];
+            for (unsigned int j = 0; j < remaining[v]; j++) {
+                if (list[j] == best) {
+                    list[j] = list[--remaining[v]];
+                    break;
+                }
+            }
+        }
+        current.triangle_count++;
+        centroid_sum += centroids[best];
+    }
+    finish();
+    return data;
+}
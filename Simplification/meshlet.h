@@ -0,0 +1,35 @@
+#ifndef SIMPLIFICATION_MESHLET_H
+#define SIMPLIFICATION_MESHLET_H
+
+#include "model/meshData.h"
+
+const unsigned int MAX_MESHLET_VERTICES = 64;
+const unsigned int MAX_MESHLET_TRIANGLES = 124;
+
+struct Meshlet {
+    // ranges in MeshletData::meshlet_vertices and MeshletData::meshlet_triangles (in triangles)
+    unsigned int vertex_offset, vertex_count;
+    unsigned int triangle_offset, triangle_count;
+    // bounding sphere
+    glm::vec3 center;
+    float radius;
+    // normal cone, every triangle faces away from eye when dot(normalize(cone_apex - eye), cone_axis) >= cone_cutoff
+    glm::vec3 cone_apex;
+    glm::vec3 cone_axis;
+    float cone_cutoff;
+};
+
+struct MeshletData {
+    // vertex buffer shared by all meshlets
+    vector<Vertex> vertices;
+    // vertex list of each meshlet, indices into vertices
+    vector<unsigned int> meshlet_vertices;
+    // triangles of each meshlet, 3 indices into its vertex list
+    vector<unsigned char> meshlet_triangles;
+    vector<Meshlet> meshlets;
+};
+
+MeshletData build_meshlets(vector<Vertex> vertices, const vector<unsigned int> & indices,
+                           unsigned int max_vertices = MAX_MESHLET_VERTICES, unsigned int max_triangles = MAX_MESHLET_TRIANGLES);
+
+#endif //SIMPLIFICATION_MESHLET_H
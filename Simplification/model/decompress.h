@@ -0,0 +1,110 @@
+#ifndef SIMPLIFICATION_DECOMPRESS_H
+#define SIMPLIFICATION_DECOMPRESS_H
+
+#include "mappedFile.h"
+#include "textParse.h"
+#include <zlib.h>
+#ifdef SIMPLIFICATION_ZSTD
+#include <zstd.h>
+#endif
+
+#include <cstring>
+#include <vector>
+using namespace std;
+
+const size_t DECOMPRESS_BLOCK_SIZE = 1 << 22;
+
+inline bool has_suffix(const char * path, const char * suffix) {
+    size_t n = strlen(path), m = strlen(suffix);
+    return n >= m && strcmp(path + n - m, suffix) == 0;
+}
+
+// .gz always, .zst when built with SIMPLIFICATION_ZSTD
+inline bool is_compressed(const char * path) {
+#ifdef SIMPLIFICATION_ZSTD
+    if (has_suffix(path, ".zst")) return true;
+#endif
+    return has_suffix(path, ".gz");
+}
+
+/*
+ * Decompresses path and calls on_block(vector<char> &&) with blocks of whole lines,
+ * about DECOMPRESS_BLOCK_SIZE each, the last one may lack its final newline
+ * read(buffer, size) fills from the decompressor and returns the bytes produced, 0 at the end, -1 on error
+ */
+template <typename R, typename F>
+bool split_lines(R read, F on_block) {
+    vector<char> block;
+    size_t filled = 0;
+    while (true) {
+        block.resize(filled + DECOMPRESS_BLOCK_SIZE);
+        long long n = read(block.data() + filled, DECOMPRESS_BLOCK_SIZE);
+        if (n < 0)
+            return false;
+        filled += n;
+        if (n == 0) {
+            if (filled) {
+                block.resize(filled);
+                on_block(std::move(block));
+            }
+            return true;
+        }
+        const char * last = last_newline(block.data(), block.data() + filled);
+        if (!last || filled < DECOMPRESS_BLOCK_SIZE)
+            continue;
+        // the partial last line starts the next block
+        size_t whole = last + 1 - block.data();
+        vector<char> next(block.begin() + whole, block.begin() + filled);
+        block.resize(whole);
+        on_block(std::move(block));
+        block = std::move(next);
+        filled = block.size();
+    }
+}
+
+template <typename F>
+bool decompress_lines(const char * path, F on_block) {
+#ifdef SIMPLIFICATION_ZSTD
+    if (has_suffix(path, ".zst")) {
+        MappedFile file(path);
+        if (!file.valid())
+            return false;
+        ZSTD_DStream * stream = ZSTD_createDStream();
+        ZSTD_initDStream(stream);
+        ZSTD_inBuffer input {file.data(), file.size(), 0};
+        bool ok = split_lines([&](char * buffer, size_t size) -> long long {
+            ZSTD_outBuffer output {buffer, size, 0};
+            while (output.pos < output.size) {
+                size_t in = input.pos, out = output.pos;
+                size_t result = ZSTD_decompressStream(stream, &output, &input);
+                if (ZSTD_isError(result))
+                    return -1;
+                // input used up and nothing left buffered in the decoder
+                if (input.pos == in && output.pos == out)
+                    break;
+            }
+            return (long long) output.pos;
+        }, on_block);
+        ZSTD_freeDStream(stream);
+        return ok;
+    }
+#endif
+    gzFile file = gzopen(path, "rb");
+    if (!file)
+        return false;
+    gzbuffer(file, 1 << 17);
+    bool ok = split_lines([&](char * buffer, size_t size) -> long long {
+        size_t done = 0;
+        while (done < size) {
+            int n = gzread(file, buffer + done, (unsigned int) (size - done));
+            if (n < 0) return -1;
+            if (n == 0) break;
+            done += n;
+        }
+        return (long long) done;
+    }, on_block);
+    gzclose(file);
+    return ok;
+}
+
+#endif //SIMPLIFICATION_DECOMPRESS_H
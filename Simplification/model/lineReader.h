@@ -0,0 +1,72 @@
+#ifndef SIMPLIFICATION_LINEREADER_H
+#define SIMPLIFICATION_LINEREADER_H
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "textParse.h"
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// reads a file through one fixed buffer and hands out runs of whole lines, memory stays at the buffer size
+class LineReader {
+public:
+    explicit LineReader(const char * path, size_t buffer_size = 1 << 23) : buffer(buffer_size) {
+        fd = open(path, O_RDONLY);
+    }
+
+    ~LineReader() {
+        if (fd >= 0) close(fd);
+    }
+
+    LineReader(const LineReader &) = delete;
+    LineReader & operator=(const LineReader &) = delete;
+
+    bool valid() const { return fd >= 0 && !failed; }
+
+    // next run of complete lines in [begin, end), the last line of the file may lack its newline
+    bool next(const char *& begin, const char *& end) {
+        // keep the partial line left behind last time
+        memmove(buffer.data(), buffer.data() + consumed, filled - consumed);
+        filled -= consumed;
+        consumed = 0;
+        while (true) {
+            while (!eof && filled < buffer.size()) {
+                ssize_t n = read(fd, buffer.data() + filled, buffer.size() - filled);
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0) failed = true;
+                if (n <= 0) eof = true;
+                else filled += n;
+            }
+            if (filled == 0) return false;
+            const char * data = buffer.data();
+            const char * last = last_newline(data, data + filled);
+            if (last || eof) {
+                consumed = last && !eof ? last + 1 - data : filled;
+                begin = data;
+                end = data + consumed;
+                return true;
+            }
+            // a single line longer than the buffer
+            buffer.resize(buffer.size() * 2);
+        }
+    }
+
+    // back to the start of the file for another pass
+    bool rewind() {
+        filled = consumed = 0;
+        eof = false;
+        return fd >= 0 && lseek(fd, 0, SEEK_SET) == 0;
+    }
+
+private:
+    int fd;
+    vector<char> buffer;
+    size_t filled = 0, consumed = 0;
+    bool eof = false, failed = false;
+};
+
+#endif //SIMPLIFICATION_LINEREADER_H
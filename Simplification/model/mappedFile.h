@@ -0,0 +1,51 @@
+#ifndef SIMPLIFICATION_MAPPEDFILE_H
+#define SIMPLIFICATION_MAPPEDFILE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+
+// read-only memory mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const char * path) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            length = st.st_size;
+            if (length == 0)
+                opened = true;
+            else {
+                void * p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    base = (const char *) p;
+                    opened = true;
+                    madvise(p, length, MADV_SEQUENTIAL);
+                }
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (base) munmap((void *) base, length);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    bool valid() const { return opened; }
+    const char * data() const { return base; }
+    size_t size() const { return length; }
+
+private:
+    const char * base = nullptr;
+    size_t length = 0;
+    bool opened = false;
+};
+
+#endif //SIMPLIFICATION_MAPPEDFILE_H
@@ -8,37 +8,30 @@
 
 #include <learnopengl/shader_s.h>
 
+#include "meshData.h"
+
 #include <string>
 #include <vector>
 using namespace std;
 
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-};
-
-class Mesh {
+// mesh data uploaded to the GPU, needs a current OpenGL context
+class Mesh : public MeshData {
 public:
-    // mesh Data
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
     unsigned int VAO;
 
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices) {
-        this->vertices = vertices;
-        this->indices = indices;
-
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices) : MeshData {std::move(vertices), std::move(indices)} {
         // compute normal
-        iniNormals();
+        compute_normals(*this);
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
     }
 
+    // upload prepared data as it is, normals included
+    explicit Mesh(MeshData data) : MeshData(std::move(data)) {
+        setupMesh();
+    }
+
     // render the mesh
     void Draw(Shader shader) {
         // draw mesh
@@ -79,23 +72,6 @@ private:
 
         glBindVertexArray(0);
     }
-
-    // initialize normals
-    void iniNormals () {
-        unsigned int num_faces = indices.size() / 3;
-        for (unsigned int i = 0; i < num_faces; i++) {
-            glm::vec3 p0 = vertices[indices[i * 3]].Position;
-            glm::vec3 p1 = vertices[indices[i * 3 + 1]].Position;
-            glm::vec3 p2 = vertices[indices[i * 3 + 2]].Position;
-            glm::vec3 v0 = p1 - p0, v1 = p2 - p1;
-            glm::vec3 normal = glm::normalize(glm::cross(v0, v1));
-            vertices[indices[i * 3]].Normal += normal;
-            vertices[indices[i * 3 + 1]].Normal += normal;
-            vertices[indices[i * 3 + 2]].Normal += normal;
-        }
-        for (Vertex & vertex : vertices)
-            vertex.Normal = glm::normalize(vertex.Normal);
-    }
 };
 
 #endif //SIMPLIFICATION_MESH_H
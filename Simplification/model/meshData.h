@@ -0,0 +1,43 @@
+#ifndef SIMPLIFICATION_MESHDATA_H
+#define SIMPLIFICATION_MESHDATA_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+using namespace std;
+
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+};
+
+// mesh data on the CPU side, no OpenGL context needed
+struct MeshData {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+};
+
+// vertex normals as the average of the connected face normals
+inline void compute_normals(MeshData & data) {
+    for (Vertex & vertex : data.vertices)
+        vertex.Normal = glm::vec3(0.0f);
+    unsigned int num_faces = data.indices.size() / 3;
+    for (unsigned int i = 0; i < num_faces; i++) {
+        glm::vec3 p0 = data.vertices[data.indices[i * 3]].Position;
+        glm::vec3 p1 = data.vertices[data.indices[i * 3 + 1]].Position;
+        glm::vec3 p2 = data.vertices[data.indices[i * 3 + 2]].Position;
+        glm::vec3 v0 = p1 - p0, v1 = p2 - p1;
+        glm::vec3 normal = glm::normalize(glm::cross(v0, v1));
+        data.vertices[data.indices[i * 3]].Normal += normal;
+        data.vertices[data.indices[i * 3 + 1]].Normal += normal;
+        data.vertices[data.indices[i * 3 + 2]].Normal += normal;
+    }
+    for (Vertex & vertex : data.vertices)
+        vertex.Normal = glm::normalize(vertex.Normal);
+}
+
+#endif //SIMPLIFICATION_MESHDATA_H
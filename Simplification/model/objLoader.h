@@ -1,57 +1,383 @@
 #ifndef SIMPLIFICATION_OBJLOADER_H
 #define SIMPLIFICATION_OBJLOADER_H
 
-#include "mesh.h"
-#include <cstdio>
-
-Mesh loadOBJ(const char * path, float scale = 1.0f) {
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
-
-    string objLine;
-    ifstream objFile;
-    // ensure ifstream objects can throw exceptions:
-    objFile.exceptions(ifstream::failbit | ifstream::badbit);
-    try {
-        // open file
-        objFile.open(path);
-        while(getline(objFile, objLine)) {
-            if (objLine.substr(0, 2) == "vt") {
+#include "meshData.h"
+#include "mappedFile.h"
+#include "decompress.h"
+#include "textParse.h"
+#include "../parallel.h"
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iostream>
 
+// one triangle corner as written in the file, 0 based, relative ones counted from the chunk start
+struct ObjCorner {
+    int position, tex_coord, normal;
+    unsigned char relative;
+};
+
+static const unsigned char OBJ_RELATIVE_POSITION = 1, OBJ_RELATIVE_TEX_COORD = 2, OBJ_RELATIVE_NORMAL = 4;
+static const int OBJ_NO_INDEX = INT_MIN;
+
+// what one newline aligned slice of the file contributed
+struct ObjChunk {
+    vector<glm::vec3> positions;
+    vector<glm::vec2> tex_coords;
+    vector<glm::vec3> normals;
+    // three per triangle, polygons are already fanned
+    vector<ObjCorner> corners;
+};
+
+/*
+ * Reads one index of a v/vt/vn triplet, negative ones refer back from the
+ * count of that element read so far in this chunk
+ */
+inline const char * parse_obj_index(const char * p, const char * end, size_t local_count,
+                                    unsigned char flag, int & index, unsigned char & relative) {
+    long long value = 0;
+    const char * q = parse_int(p, end, value);
+    if (q == p || value == 0) {
+        index = OBJ_NO_INDEX;
+        return q;
+    }
+    if (value < 0) {
+        index = (int) (local_count + value);
+        relative |= flag;
+    }
+    else
+        index = (int) (value - 1);
+    return q;
+}
+
+inline const char * parse_obj_corner(const char * p, const char * end, const ObjChunk & chunk, ObjCorner & corner) {
+    corner.relative = 0;
+    corner.tex_coord = corner.normal = OBJ_NO_INDEX;
+    p = parse_obj_index(p, end, chunk.positions.size(), OBJ_RELATIVE_POSITION, corner.position, corner.relative);
+    if (p < end && *p == '/') {
+        p++;
+        if (p < end && *p != '/')
+            p = parse_obj_index(p, end, chunk.tex_coords.size(), OBJ_RELATIVE_TEX_COORD, corner.tex_coord, corner.relative);
+        if (p < end && *p == '/')
+            p = parse_obj_index(p + 1, end, chunk.normals.size(), OBJ_RELATIVE_NORMAL, corner.normal, corner.relative);
+    }
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r') p++;
+    return p;
+}
+
+inline void parse_obj_chunk(const char * p, const char * end, ObjChunk & chunk) {
+    while (p < end) {
+        const char * line_end = (const char *) memchr(p, '\n', end - p);
+        if (!line_end) line_end = end;
+        p = skip_space(p, line_end);
+        if (line_end - p > 1 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            glm::vec3 position(0.0f);
+            const char * q = p + 2;
+            for (int i = 0; i < 3; i++)
+                q = parse_float(skip_space(q, line_end), line_end, position[i]);
+            chunk.positions.push_back(position);
+        }
+        else if (line_end - p > 2 && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t')) {
+            glm::vec2 tex_coord(0.0f);
+            const char * q = p + 3;
+            for (int i = 0; i < 2; i++)
+                q = parse_float(skip_space(q, line_end), line_end, tex_coord[i]);
+            chunk.tex_coords.push_back(tex_coord);
+        }
+        else if (line_end - p > 2 && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+            glm::vec3 normal(0.0f);
+            const char * q = p + 3;
+            for (int i = 0; i < 3; i++)
+                q = parse_float(skip_space(q, line_end), line_end, normal[i]);
+            chunk.normals.push_back(normal);
+        }
+        else if (line_end - p > 1 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            // fan around the first corner, a triangle is emitted for every corner past the second
+            ObjCorner first, previous, corner;
+            int count = 0;
+            const char * q = skip_space(p + 2, line_end);
+            while (q < line_end) {
+                const char * next = parse_obj_corner(q, line_end, chunk, corner);
+                if (corner.position == OBJ_NO_INDEX) break;
+                if (count == 0) first = corner;
+                else if (count >= 2) {
+                    chunk.corners.push_back(first);
+                    chunk.corners.push_back(previous);
+                    chunk.corners.push_back(corner);
+                }
+                previous = corner;
+                count++;
+                q = skip_space(next, line_end);
             }
-            else if (objLine.substr(0, 2) == "vn") {
+        }
+        p = line_end + 1;
+    }
+}
 
+// global 0 based index of a corner element, -1 when absent or out of range
+inline long long resolve_obj_index(int index, bool relative, size_t base, size_t total) {
+    if (index == OBJ_NO_INDEX) return -1;
+    long long value = relative ? (long long) base + index : index;
+    return value >= 0 && value < (long long) total ? value : -1;
+}
+
+/*
+ * Decompression runs on its own thread and hands blocks of whole lines through a bounded queue
+ * to parser threads, so both overlap. Every block becomes one chunk in file order
+ */
+inline bool parse_compressed_obj(const char * path, vector<ObjChunk> & chunks) {
+    // hardware_concurrency is 0 when unknown
+    unsigned int parsers = max(2u, thread::hardware_concurrency()) - 1;
+    BlockingQueue<pair<size_t, vector<char>>> queue(parsers * 2);
+    mutex chunks_guard;
+    bool ok = true;
+
+    thread producer([&] {
+        size_t id = 0;
+        ok = decompress_lines(path, [&](vector<char> && block) {
+            queue.push(make_pair(id++, std::move(block)));
+        });
+        queue.close();
+    });
+    parallel_run(parsers, [&](unsigned int) {
+        pair<size_t, vector<char>> block;
+        while (queue.pop(block)) {
+            ObjChunk chunk;
+            parse_obj_chunk(block.second.data(), block.second.data() + block.second.size(), chunk);
+            vector<char>().swap(block.second);
+            lock_guard<mutex> lock(chunks_guard);
+            if (chunks.size() <= block.first)
+                chunks.resize(block.first + 1);
+            chunks[block.first] = std::move(chunk);
+        }
+    });
+    producer.join();
+    return ok;
+}
+
+/*
+ * Chunks are copied to their prefix sum offsets in the output.
+ * Vertices are per position, texture coordinates and normals come from
+ * the first corner referencing that position
+ */
+inline MeshData merge_obj_chunks(vector<ObjChunk> & chunks, float scale) {
+    MeshData mesh;
+    // an empty compressed file has no blocks
+    if (chunks.empty())
+        return mesh;
+    size_t num_chunks = chunks.size();
+    vector<size_t> vertex_offset(num_chunks + 1, 0), tex_coord_offset(num_chunks + 1, 0),
+                   normal_offset(num_chunks + 1, 0), index_offset(num_chunks + 1, 0);
+    for (size_t t = 0; t < num_chunks; t++) {
+        vertex_offset[t + 1] = vertex_offset[t] + chunks[t].positions.size();
+        tex_coord_offset[t + 1] = tex_coord_offset[t] + chunks[t].tex_coords.size();
+        normal_offset[t + 1] = normal_offset[t] + chunks[t].normals.size();
+        index_offset[t + 1] = index_offset[t] + chunks[t].corners.size();
+    }
+    size_t num_vertices = vertex_offset[num_chunks], num_tex_coords = tex_coord_offset[num_chunks],
+           num_normals = normal_offset[num_chunks];
+    mesh.vertices.resize(num_vertices);
+    mesh.indices.resize(index_offset[num_chunks]);
+
+    // one chunk per block on the compressed path, far more than there are cores
+    parallel_for(num_chunks, [&](unsigned int, size_t begin, size_t end) {
+        for (size_t t = begin; t < end; t++) {
+            Vertex * vertex = mesh.vertices.data() + vertex_offset[t];
+            for (const glm::vec3 & position : chunks[t].positions) {
+                vertex->Position = position * scale;
+                vertex->Normal = glm::vec3(0.0f);
+                vertex->TexCoords = glm::vec2(0.0f);
+                vertex++;
             }
-            else if (objLine.substr(0, 1) == "v") {
-                Vertex vertex;
-                istringstream s(objLine.substr(2));
-                float x, y, z;
-                s >> x; s >> y; s >> z;
-                vertex.Position = glm::vec3(x * scale, y * scale, z * scale);
-                vertices.push_back(vertex);
+            vector<glm::vec3>().swap(chunks[t].positions);
+
+            unsigned int * index = mesh.indices.data() + index_offset[t];
+            for (const ObjCorner & corner : chunks[t].corners) {
+                long long position = resolve_obj_index(corner.position, corner.relative & OBJ_RELATIVE_POSITION,
+                                                       vertex_offset[t], num_vertices);
+                *index++ = position < 0 ? UINT_MAX : (unsigned int) position;
             }
-            else if (objLine.substr(0, 1) == "f") {
-                string v0, v1, v2;
-                istringstream s(objLine.substr(2));
-                s >> v0 >> v1 >> v2;
-                unsigned int index;
-                s = istringstream(v0);
-                s >> index;
-                indices.push_back(index - 1);
-                s = istringstream(v1);
-                s >> index;
-                indices.push_back(index - 1);
-                s = istringstream(v2);
-                s >> index;
-                indices.push_back(index - 1);
+        }
+    }, 1);
+
+    // attributes are taken in file order so the first corner wins
+    bool has_normals = num_normals > 0;
+    if (num_tex_coords > 0 || num_normals > 0) {
+        vector<glm::vec2> tex_coords;
+        vector<glm::vec3> normals;
+        tex_coords.reserve(num_tex_coords);
+        normals.reserve(num_normals);
+        for (const ObjChunk & chunk : chunks) {
+            tex_coords.insert(tex_coords.end(), chunk.tex_coords.begin(), chunk.tex_coords.end());
+            normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+        }
+        vector<bool> assigned(num_vertices, false);
+        for (size_t t = 0; t < num_chunks; t++) {
+            const unsigned int * index = mesh.indices.data() + index_offset[t];
+            for (const ObjCorner & corner : chunks[t].corners) {
+                unsigned int v = *index++;
+                if (v == UINT_MAX || assigned[v]) continue;
+                assigned[v] = true;
+                long long tex_coord = resolve_obj_index(corner.tex_coord, corner.relative & OBJ_RELATIVE_TEX_COORD,
+                                                        tex_coord_offset[t], num_tex_coords);
+                long long normal = resolve_obj_index(corner.normal, corner.relative & OBJ_RELATIVE_NORMAL,
+                                                     normal_offset[t], num_normals);
+                if (tex_coord >= 0) mesh.vertices[v].TexCoords = tex_coords[tex_coord];
+                if (normal >= 0) mesh.vertices[v].Normal = normals[normal];
+                else has_normals = false;
             }
         }
+        for (bool a : assigned)
+            if (!a) has_normals = false;
+    }
+
+    // triangles referencing missing positions are dropped
+    size_t kept = 0;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        if (mesh.indices[i] == UINT_MAX || mesh.indices[i + 1] == UINT_MAX || mesh.indices[i + 2] == UINT_MAX)
+            continue;
+        for (int j = 0; j < 3; j++)
+            mesh.indices[kept++] = mesh.indices[i + j];
     }
-    catch (ifstream::failure & e) {
+    if (kept != mesh.indices.size()) {
+        cout << "ERROR::MODEL::OBJLOADER::INDEX_OUT_OF_RANGE" << endl;
+        mesh.indices.resize(kept);
+    }
+
+    if (!has_normals)
+        compute_normals(mesh);
+    return mesh;
+}
+
+/*
+ * The file is mapped and cut into newline aligned chunks parsed in parallel.
+ * Files ending in .gz, or .zst with SIMPLIFICATION_ZSTD, are decompressed while they are parsed
+ */
+inline MeshData loadOBJ(const char * path, float scale = 1.0f) {
+    vector<ObjChunk> chunks;
+    if (is_compressed(path)) {
+        if (!parse_compressed_obj(path, chunks)) {
+            cout << "ERROR::MODEL::OBJLOADER::FILE_NOT_SUCCESFULLY_READ" << endl;
+            return MeshData();
+        }
+        return merge_obj_chunks(chunks, scale);
+    }
+
+    MappedFile file(path);
+    if (!file.valid()) {
         cout << "ERROR::MODEL::OBJLOADER::FILE_NOT_SUCCESFULLY_READ" << endl;
+        return MeshData();
     }
+    const char * data = file.data();
+    size_t size = file.size();
+
+    unsigned int threads = thread_count(size, 1 << 20);
+    vector<const char *> bounds(threads + 1);
+    bounds[0] = data;
+    bounds[threads] = data + size;
+    for (unsigned int t = 1; t < threads; t++)
+        bounds[t] = max(bounds[t - 1], next_line(data + size * t / threads, data + size));
 
-    return Mesh(vertices, indices);
+    chunks.resize(threads);
+    parallel_run(threads, [&](unsigned int t) {
+        parse_obj_chunk(bounds[t], bounds[t + 1], chunks[t]);
+    });
+    return merge_obj_chunks(chunks, scale);
+}
+
+// write() until everything is out, false on error
+inline bool write_all(int fd, const char * data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+/*
+ * Formats count lines with fn(out, i) into one buffer per chunk of CHUNK_LINES lines,
+ * a batch of chunks in parallel, then writes each chunk with a single write in order
+ * line_bytes bounds what fn writes for one line
+ */
+template <typename F>
+bool write_obj_lines(int fd, size_t count, size_t line_bytes, F fn) {
+    const size_t CHUNK_LINES = 1 << 16;
+    size_t num_chunks = (count + CHUNK_LINES - 1) / CHUNK_LINES;
+    unsigned int threads = (unsigned int) max(size_t(1), min(num_chunks, size_t(thread_count(count, CHUNK_LINES))));
+    vector<vector<char>> buffers(threads, vector<char>(CHUNK_LINES * line_bytes));
+    vector<size_t> sizes(threads);
+    for (size_t first = 0; first < num_chunks; first += threads) {
+        unsigned int batch = (unsigned int) min(size_t(threads), num_chunks - first);
+        parallel_run(batch, [&](unsigned int t) {
+            size_t begin = (first + t) * CHUNK_LINES, end = min(count, begin + CHUNK_LINES);
+            char * out = buffers[t].data();
+            for (size_t i = begin; i < end; i++)
+                out = fn(out, i);
+            sizes[t] = out - buffers[t].data();
+        });
+        for (unsigned int t = 0; t < batch; t++)
+            if (!write_all(fd, buffers[t].data(), sizes[t]))
+                return false;
+    }
+    return true;
+}
+
+/*
+ * Writes v lines, vn lines when normals is set, and 1 based f lines
+ * Numbers are formatted by hand, 9 significant digits so floats read back unchanged
+ */
+inline bool writeOBJ(const char * path, const MeshData & mesh, bool normals = false) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        cout << "ERROR::MODEL::OBJLOADER::FILE_NOT_SUCCESFULLY_WRITTEN" << endl;
+        return false;
+    }
+    const Vertex * vertices = mesh.vertices.data();
+    const unsigned int * indices = mesh.indices.data();
+    auto vector_line = [](char * out, const char * tag, const glm::vec3 & v) {
+        while (*tag) *out++ = *tag++;
+        for (int k = 0; k < 3; k++) {
+            *out++ = ' ';
+            out = format_float(out, v[k]);
+        }
+        *out++ = '\n';
+        return out;
+    };
+
+    bool ok = write_obj_lines(fd, mesh.vertices.size(), 64, [&](char * out, size_t i) {
+        return vector_line(out, "v", vertices[i].Position);
+    });
+    if (ok && normals)
+        ok = write_obj_lines(fd, mesh.vertices.size(), 64, [&](char * out, size_t i) {
+            return vector_line(out, "vn", vertices[i].Normal);
+        });
+    if (ok)
+        ok = write_obj_lines(fd, mesh.indices.size() / 3, 80, [&](char * out, size_t f) {
+            *out++ = 'f';
+            for (int k = 0; k < 3; k++) {
+                *out++ = ' ';
+                char * number = out;
+                out = format_uint(out, indices[f * 3 + k] + 1);
+                if (normals) {
+                    *out++ = '/';
+                    *out++ = '/';
+                    size_t length = out - 2 - number;
+                    memcpy(out, number, length);
+                    out += length;
+                }
+            }
+            *out++ = '\n';
+            return out;
+        });
+    ok = close(fd) == 0 && ok;
+    if (!ok)
+        cout << "ERROR::MODEL::OBJLOADER::FILE_NOT_SUCCESFULLY_WRITTEN" << endl;
+    return ok;
 }
 
 #endif //SIMPLIFICATION_OBJLOADER_H
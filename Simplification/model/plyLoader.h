@@ -0,0 +1,416 @@
+#ifndef SIMPLIFICATION_PLYLOADER_H
+#define SIMPLIFICATION_PLYLOADER_H
+
+#include "meshData.h"
+#include "mappedFile.h"
+#include "textParse.h"
+#include "../parallel.h"
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sstream>
+#include <iostream>
+
+enum PlyType { PLY_NONE, PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64 };
+
+struct PlyProperty {
+    string name;
+    PlyType type;
+    // PLY_NONE unless this is a list property
+    PlyType count_type;
+};
+
+struct PlyElement {
+    string name;
+    size_t count;
+    vector<PlyProperty> properties;
+};
+
+inline PlyType ply_type(const string & name) {
+    if (name == "char" || name == "int8") return PLY_INT8;
+    if (name == "uchar" || name == "uint8") return PLY_UINT8;
+    if (name == "short" || name == "int16") return PLY_INT16;
+    if (name == "ushort" || name == "uint16") return PLY_UINT16;
+    if (name == "int" || name == "int32") return PLY_INT32;
+    if (name == "uint" || name == "uint32") return PLY_UINT32;
+    if (name == "float" || name == "float32") return PLY_FLOAT32;
+    if (name == "double" || name == "float64") return PLY_FLOAT64;
+    return PLY_NONE;
+}
+
+inline size_t ply_size(PlyType type) {
+    static const size_t sizes[] = {0, 1, 1, 2, 2, 4, 4, 4, 8};
+    return sizes[type];
+}
+
+inline bool host_big_endian() {
+    const unsigned short probe = 1;
+    return *(const unsigned char *) &probe == 0;
+}
+
+// one binary value converted to double, bytes reversed when the file endianness differs
+inline double ply_value(const char * p, PlyType type, bool swap) {
+    unsigned char bytes[8];
+    size_t size = ply_size(type);
+    for (size_t i = 0; i < size; i++)
+        bytes[i] = p[swap ? size - 1 - i : i];
+    switch (type) {
+        case PLY_INT8: { signed char v; memcpy(&v, bytes, 1); return v; }
+        case PLY_UINT8: return bytes[0];
+        case PLY_INT16: { short v; memcpy(&v, bytes, 2); return v; }
+        case PLY_UINT16: { unsigned short v; memcpy(&v, bytes, 2); return v; }
+        case PLY_INT32: { int v; memcpy(&v, bytes, 4); return v; }
+        case PLY_UINT32: { unsigned int v; memcpy(&v, bytes, 4); return v; }
+        case PLY_FLOAT32: { float v; memcpy(&v, bytes, 4); return v; }
+        case PLY_FLOAT64: { double v; memcpy(&v, bytes, 8); return v; }
+        default: return 0.0;
+    }
+}
+
+inline const char * skip_blank(const char * p, const char * end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+    return p;
+}
+
+// reads one value in the file format and advances p, false at the end of the data
+inline bool read_ply_value(const char *& p, const char * end, PlyType type, int format, bool swap, double & value) {
+    if (format == 0) {
+        const char * s = skip_blank(p, end), * q;
+        if (type == PLY_FLOAT32 || type == PLY_FLOAT64) {
+            float f = 0.0f;
+            q = parse_float(s, end, f);
+            value = f;
+        }
+        else {
+            long long i = 0;
+            q = parse_int(s, end, i);
+            value = (double) i;
+        }
+        if (q == s) return false;
+        p = q;
+        return true;
+    }
+    size_t size = ply_size(type);
+    if ((size_t) (end - p) < size) return false;
+    value = ply_value(p, type, swap);
+    p += size;
+    return true;
+}
+
+/*
+ * Walks every value of an element, fn(item, property, list position, value)
+ * Scalar properties report list position 0
+ */
+template <typename F>
+bool read_ply_element(const char *& p, const char * end, const PlyElement & element, int format, bool swap, F fn) {
+    for (size_t e = 0; e < element.count; e++) {
+        for (size_t i = 0; i < element.properties.size(); i++) {
+            const PlyProperty & property = element.properties[i];
+            double count = 1.0;
+            if (property.count_type != PLY_NONE && !read_ply_value(p, end, property.count_type, format, swap, count))
+                return false;
+            for (size_t c = 0; c < (size_t) max(0.0, count); c++) {
+                double value;
+                if (!read_ply_value(p, end, property.type, format, swap, value)) return false;
+                fn(e, i, c, value);
+            }
+        }
+    }
+    return true;
+}
+
+// fewest bytes one item of the element can take, a list counts as empty and an ASCII value as one character
+inline size_t ply_min_item_bytes(const PlyElement & element, int format) {
+    size_t bytes = 0;
+    for (const PlyProperty & property : element.properties)
+        bytes += format == 0 ? 1 : ply_size(property.count_type != PLY_NONE ? property.count_type : property.type);
+    return max(bytes, size_t(1));
+}
+
+// parses the header, returns the start of the data or nullptr
+inline const char * read_ply_header(const char * data, size_t size, vector<PlyElement> & elements, int & format) {
+    const char * end = data + size;
+    if (size < 4 || memcmp(data, "ply", 3) != 0) return nullptr;
+    const char * p = data;
+    while (p < end) {
+        const char * line_end = (const char *) memchr(p, '\n', end - p);
+        if (!line_end) return nullptr;
+        istringstream line(string(p, line_end));
+        p = line_end + 1;
+        string keyword;
+        line >> keyword;
+        if (keyword == "format") {
+            string name;
+            line >> name;
+            if (name == "ascii") format = 0;
+            else if (name == "binary_little_endian") format = 1;
+            else if (name == "binary_big_endian") format = 2;
+            else return nullptr;
+        }
+        else if (keyword == "element") {
+            PlyElement element;
+            line >> element.name >> element.count;
+            elements.push_back(element);
+        }
+        else if (keyword == "property" && !elements.empty()) {
+            PlyProperty property;
+            string type;
+            line >> type;
+            if (type == "list") {
+                string count_type, item_type;
+                line >> count_type >> item_type;
+                property.count_type = ply_type(count_type);
+                property.type = ply_type(item_type);
+                if (property.count_type == PLY_NONE) return nullptr;
+            }
+            else {
+                property.count_type = PLY_NONE;
+                property.type = ply_type(type);
+            }
+            if (property.type == PLY_NONE) return nullptr;
+            line >> property.name;
+            elements.back().properties.push_back(property);
+        }
+        else if (keyword == "end_header")
+            return p;
+    }
+    return nullptr;
+}
+
+inline int ply_property_index(const PlyElement & element, const char * name, const char * other = nullptr) {
+    for (size_t i = 0; i < element.properties.size(); i++)
+        if (element.properties[i].name == name || (other && element.properties[i].name == other))
+            return (int) i;
+    return -1;
+}
+
+/*
+ * Reads ASCII and binary little or big endian PLY files, vertex positions, normals
+ * and texture coordinates plus fan triangulated faces. Other elements are skipped.
+ * Binary float32 xyz vertices and uchar count + int32 triangle faces are copied
+ * straight from the mapped file without per value conversion
+ */
+inline MeshData loadPLY(const char * path, float scale = 1.0f) {
+    MeshData mesh;
+    MappedFile file(path);
+    if (!file.valid()) {
+        cout << "ERROR::MODEL::PLYLOADER::FILE_NOT_SUCCESFULLY_READ" << endl;
+        return mesh;
+    }
+    vector<PlyElement> elements;
+    int format = -1;
+    const char * p = read_ply_header(file.data(), file.size(), elements, format);
+    const char * end = file.data() + file.size();
+    if (!p || format < 0) {
+        cout << "ERROR::MODEL::PLYLOADER::INVALID_HEADER" << endl;
+        return mesh;
+    }
+    bool swap = format == 2 ? !host_big_endian() : format == 1 ? host_big_endian() : false;
+    bool has_normals = false;
+    bool truncated = false;
+
+    for (const PlyElement & element : elements) {
+        size_t num_props = element.properties.size();
+        bool fixed = true;
+        size_t stride = 0;
+        vector<size_t> offsets(num_props);
+        for (size_t i = 0; i < num_props; i++) {
+            offsets[i] = stride;
+            if (element.properties[i].count_type != PLY_NONE) fixed = false;
+            stride += ply_size(element.properties[i].type);
+        }
+        // a count the rest of the file can not hold is rejected before anything is allocated for it,
+        // dividing the remaining bytes so a huge count can not overflow
+        size_t remaining = (size_t) (end - p);
+        bool fits = element.count <= remaining / ply_min_item_bytes(element, format);
+
+        if (element.name == "vertex") {
+            if (!fits) { truncated = true; break; }
+            int slots[8] = {
+                ply_property_index(element, "x"), ply_property_index(element, "y"), ply_property_index(element, "z"),
+                ply_property_index(element, "nx"), ply_property_index(element, "ny"), ply_property_index(element, "nz"),
+                ply_property_index(element, "u", "s"), ply_property_index(element, "v", "t")
+            };
+            has_normals = slots[3] >= 0 && slots[4] >= 0 && slots[5] >= 0;
+            mesh.vertices.assign(element.count, Vertex{glm::vec3(0.0f), glm::vec3(0.0f), glm::vec2(0.0f)});
+            bool float_slots = true;
+            for (int slot : slots)
+                if (slot >= 0 && element.properties[slot].type != PLY_FLOAT32) float_slots = false;
+
+            // fits already holds count * stride bytes when the layout is fixed
+            if (format > 0 && fixed) {
+                const char * base = p;
+                parallel_for(element.count, [&](unsigned int, size_t begin, size_t last) {
+                    for (size_t v = begin; v < last; v++) {
+                        const char * item = base + v * stride;
+                        float * out = &mesh.vertices[v].Position.x;
+                        for (int k = 0; k < 8; k++) {
+                            if (slots[k] < 0) continue;
+                            if (float_slots && !swap)
+                                memcpy(&out[k], item + offsets[slots[k]], 4);
+                            else
+                                out[k] = (float) ply_value(item + offsets[slots[k]], element.properties[slots[k]].type, swap);
+                        }
+                    }
+                });
+                p += element.count * stride;
+            }
+            else {
+                truncated = !read_ply_element(p, end, element, format, swap,
+                    [&](size_t v, size_t i, size_t c, double value) {
+                        if (c > 0 || element.properties[i].count_type != PLY_NONE) return;
+                        for (int k = 0; k < 8; k++)
+                            if (slots[k] == (int) i) (&mesh.vertices[v].Position.x)[k] = (float) value;
+                    });
+            }
+            for (Vertex & vertex : mesh.vertices)
+                vertex.Position *= scale;
+        }
+        else if (element.name == "face") {
+            int list = ply_property_index(element, "vertex_indices", "vertex_index");
+            if (list < 0 || element.properties[list].count_type == PLY_NONE) {
+                cout << "ERROR::MODEL::PLYLOADER::NO_VERTEX_INDICES" << endl;
+                return MeshData();
+            }
+            const PlyProperty & indices = element.properties[list];
+            if (!fits) { truncated = true; break; }
+
+            // the common scanner layout: only triangles as uchar 3 followed by three 32 bit indices
+            bool triangles = format > 0 && !swap && num_props == 1 && indices.count_type == PLY_UINT8 &&
+                             (indices.type == PLY_INT32 || indices.type == PLY_UINT32) &&
+                             element.count <= remaining / 13;
+            if (triangles) {
+                atomic<bool> all_triangles(true);
+                const char * base = p;
+                parallel_for(element.count, [&](unsigned int, size_t begin, size_t last) {
+                    for (size_t f = begin; f < last; f++)
+                        if (base[f * 13] != 3) { all_triangles = false; return; }
+                });
+                triangles = all_triangles;
+            }
+            if (triangles) {
+                mesh.indices.resize(element.count * 3);
+                const char * base = p;
+                parallel_for(element.count, [&](unsigned int, size_t begin, size_t last) {
+                    for (size_t f = begin; f < last; f++)
+                        memcpy(&mesh.indices[f * 3], base + f * 13 + 1, 12);
+                });
+                p += element.count * 13;
+            }
+            else {
+                // fan around the first corner of every polygon
+                // reserved for as many triangles as the remaining bytes can hold
+                size_t triangle_bytes = format == 0 ? 4 : ply_size(indices.count_type) + 3 * ply_size(indices.type);
+                mesh.indices.reserve(min(element.count, remaining / triangle_bytes) * 3);
+                unsigned int first = 0, previous = 0;
+                truncated = !read_ply_element(p, end, element, format, swap,
+                    [&](size_t, size_t i, size_t c, double value) {
+                        if ((int) i != list) return;
+                        // negative or huge values are marked out of range before the cast, and dropped below
+                        unsigned int index = value >= 0.0 && value < (double) UINT_MAX ? (unsigned int) value : UINT_MAX;
+                        if (c == 0) first = index;
+                        else if (c >= 2) {
+                            mesh.indices.push_back(first);
+                            mesh.indices.push_back(previous);
+                            mesh.indices.push_back(index);
+                        }
+                        previous = index;
+                    });
+            }
+        }
+        else if (format > 0 && fixed) {
+            if (stride > 0 && element.count > remaining / stride) { truncated = true; break; }
+            p += element.count * stride;
+        }
+        else
+            truncated = !read_ply_element(p, end, element, format, swap, [](size_t, size_t, size_t, double) {});
+        if (truncated) break;
+    }
+
+    if (truncated) {
+        cout << "ERROR::MODEL::PLYLOADER::UNEXPECTED_END_OF_FILE" << endl;
+        return MeshData();
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        if (mesh.indices[i] >= mesh.vertices.size() || mesh.indices[i + 1] >= mesh.vertices.size() ||
+            mesh.indices[i + 2] >= mesh.vertices.size())
+            continue;
+        for (int j = 0; j < 3; j++)
+            mesh.indices[kept++] = mesh.indices[i + j];
+    }
+    if (kept != mesh.indices.size()) {
+        cout << "ERROR::MODEL::PLYLOADER::INDEX_OUT_OF_RANGE" << endl;
+        mesh.indices.resize(kept);
+    }
+
+    if (!has_normals)
+        compute_normals(mesh);
+    return mesh;
+}
+
+/*
+ * Writes positions, normals, texture coordinates and triangles,
+ * binary little endian by default or ASCII
+ */
+inline bool writePLY(const char * path, const MeshData & mesh, bool binary = true) {
+    FILE * file = fopen(path, "wb");
+    if (!file) {
+        cout << "ERROR::MODEL::PLYLOADER::FILE_NOT_SUCCESFULLY_WRITTEN" << endl;
+        return false;
+    }
+    size_t num_faces = mesh.indices.size() / 3;
+    fprintf(file, "ply\nformat %s 1.0\n", binary ? "binary_little_endian" : "ascii");
+    fprintf(file, "element vertex %zu\n", mesh.vertices.size());
+    fprintf(file, "property float x\nproperty float y\nproperty float z\n");
+    fprintf(file, "property float nx\nproperty float ny\nproperty float nz\n");
+    fprintf(file, "property float u\nproperty float v\n");
+    fprintf(file, "element face %zu\n", num_faces);
+    fprintf(file, "property list uchar int vertex_indices\nend_header\n");
+
+    bool ok = true;
+    if (binary) {
+        bool swap = host_big_endian();
+        auto put = [swap](char * out, const void * value, size_t size) {
+            for (size_t i = 0; i < size; i++)
+                out[i] = ((const char *) value)[swap ? size - 1 - i : i];
+        };
+        // Vertex is exactly the eight floats of the vertex block
+        if (sizeof(Vertex) == 8 * sizeof(float) && !swap)
+            ok = fwrite(mesh.vertices.data(), sizeof(Vertex), mesh.vertices.size(), file) == mesh.vertices.size();
+        else {
+            vector<char> block(mesh.vertices.size() * 32);
+            for (size_t v = 0; v < mesh.vertices.size(); v++) {
+                const float * in = &mesh.vertices[v].Position.x;
+                for (int k = 0; k < 8; k++)
+                    put(&block[v * 32 + k * 4], &in[k], 4);
+            }
+            ok = fwrite(block.data(), 1, block.size(), file) == block.size();
+        }
+        vector<char> faces(num_faces * 13);
+        parallel_for(num_faces, [&](unsigned int, size_t begin, size_t last) {
+            for (size_t f = begin; f < last; f++) {
+                faces[f * 13] = 3;
+                for (int j = 0; j < 3; j++)
+                    put(&faces[f * 13 + 1 + j * 4], &mesh.indices[f * 3 + j], 4);
+            }
+        });
+        ok = ok && fwrite(faces.data(), 1, faces.size(), file) == faces.size();
+    }
+    else {
+        for (const Vertex & v : mesh.vertices)
+            fprintf(file, "%.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g\n", v.Position.x, v.Position.y, v.Position.z,
+                    v.Normal.x, v.Normal.y, v.Normal.z, v.TexCoords.x, v.TexCoords.y);
+        for (size_t f = 0; f < num_faces; f++)
+            fprintf(file, "3 %u %u %u\n", mesh.indices[f * 3], mesh.indices[f * 3 + 1], mesh.indices[f * 3 + 2]);
+    }
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+        cout << "ERROR::MODEL::PLYLOADER::FILE_NOT_SUCCESFULLY_WRITTEN" << endl;
+    return ok;
+}
+
+#endif //SIMPLIFICATION_PLYLOADER_H
@@ -0,0 +1,129 @@
+#ifndef SIMPLIFICATION_STLLOADER_H
+#define SIMPLIFICATION_STLLOADER_H
+
+#include "meshData.h"
+#include "mappedFile.h"
+#include "textParse.h"
+#include "../parallel.h"
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+// bit pattern of a coordinate with -0 folded onto 0, so equal positions give equal keys
+inline unsigned int stl_key(float value) {
+    unsigned int bits;
+    value += 0.0f;
+    memcpy(&bits, &value, 4);
+    return bits;
+}
+
+inline size_t stl_hash(const glm::vec3 & p) {
+    unsigned long long h = stl_key(p.x) * 0x9E3779B97F4A7C15ull;
+    h ^= stl_key(p.y) * 0xC2B2AE3D27D4EB4Full;
+    h ^= stl_key(p.z) * 0x165667B19E3779F9ull;
+    return (size_t) (h ^ (h >> 29));
+}
+
+/*
+ * Welds triangle corners with exactly equal positions into shared vertices,
+ * open addressing on a power of two table, vertices keep first appearance order
+ */
+inline void weld_corners(const vector<glm::vec3> & corners, MeshData & mesh) {
+    size_t capacity = 1;
+    while (capacity < corners.size() * 2) capacity <<= 1;
+    vector<unsigned int> table(capacity, UINT_MAX);
+    vector<size_t> hashes(corners.size());
+    parallel_for(corners.size(), [&](unsigned int, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            hashes[i] = stl_hash(corners[i]);
+    });
+
+    mesh.vertices.clear();
+    mesh.indices.resize(corners.size());
+    for (size_t i = 0; i < corners.size(); i++) {
+        const glm::vec3 & p = corners[i];
+        size_t slot = hashes[i] & (capacity - 1);
+        while (table[slot] != UINT_MAX) {
+            const glm::vec3 & q = mesh.vertices[table[slot]].Position;
+            if (stl_key(p.x) == stl_key(q.x) && stl_key(p.y) == stl_key(q.y) && stl_key(p.z) == stl_key(q.z))
+                break;
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (table[slot] == UINT_MAX) {
+            table[slot] = (unsigned int) mesh.vertices.size();
+            mesh.vertices.push_back(Vertex{p, glm::vec3(0.0f), glm::vec2(0.0f)});
+        }
+        mesh.indices[i] = table[slot];
+    }
+}
+
+inline void parse_stl_ascii(const char * p, const char * end, vector<glm::vec3> & corners) {
+    while (p < end) {
+        const char * line_end = (const char *) memchr(p, '\n', end - p);
+        if (!line_end) line_end = end;
+        p = skip_space(p, line_end);
+        if (line_end - p > 6 && memcmp(p, "vertex", 6) == 0) {
+            glm::vec3 position(0.0f);
+            const char * q = p + 6;
+            for (int i = 0; i < 3; i++)
+                q = parse_float(skip_space(q, line_end), line_end, position[i]);
+            corners.push_back(position);
+        }
+        p = line_end + 1;
+    }
+}
+
+/*
+ * Reads binary or ASCII STL and welds the corners into an indexed mesh.
+ * Binary files are told apart by their size, some exporters start them with "solid" too
+ */
+inline MeshData loadSTL(const char * path, float scale = 1.0f) {
+    MeshData mesh;
+    MappedFile file(path);
+    if (!file.valid()) {
+        cout << "ERROR::MODEL::STLLOADER::FILE_NOT_SUCCESFULLY_READ" << endl;
+        return mesh;
+    }
+    const char * data = file.data();
+    size_t size = file.size();
+
+    vector<glm::vec3> corners;
+    unsigned int count = 0;
+    if (size >= 84)
+        memcpy(&count, data + 80, 4);
+    if (size >= 84 && size == 84 + (size_t) count * 50) {
+        // 12 bytes normal, three 12 byte corners, 2 bytes attributes, little endian floats
+        corners.resize((size_t) count * 3);
+        parallel_for(count, [&](unsigned int, size_t begin, size_t end) {
+            for (size_t f = begin; f < end; f++)
+                memcpy(&corners[f * 3], data + 84 + f * 50 + 12, 36);
+        });
+    }
+    else if (size >= 5 && memcmp(data, "solid", 5) == 0) {
+        unsigned int threads = thread_count(size, 1 << 20);
+        vector<const char *> bounds(threads + 1);
+        bounds[0] = data;
+        bounds[threads] = data + size;
+        for (unsigned int t = 1; t < threads; t++)
+            bounds[t] = max(bounds[t - 1], next_line(data + size * t / threads, data + size));
+        vector<vector<glm::vec3>> chunks(threads);
+        parallel_run(threads, [&](unsigned int t) {
+            parse_stl_ascii(bounds[t], bounds[t + 1], chunks[t]);
+        });
+        for (const vector<glm::vec3> & chunk : chunks)
+            corners.insert(corners.end(), chunk.begin(), chunk.end());
+        corners.resize(corners.size() / 3 * 3);
+    }
+    else {
+        cout << "ERROR::MODEL::STLLOADER::UNKNOWN_FORMAT" << endl;
+        return mesh;
+    }
+
+    weld_corners(corners, mesh);
+    for (Vertex & vertex : mesh.vertices)
+        vertex.Position *= scale;
+    compute_normals(mesh);
+    return mesh;
+}
+
+#endif //SIMPLIFICATION_STLLOADER_H
@@ -0,0 +1,165 @@
+#ifndef SIMPLIFICATION_TEXTPARSE_H
+#define SIMPLIFICATION_TEXTPARSE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+using namespace std;
+
+/*
+ * Number parsing on a [p, end) range, no allocation and no terminating zero needed
+ * Each parser returns the position after what it read, or p itself when nothing was read
+ */
+
+inline const char * skip_space(const char * p, const char * end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+inline const char * next_line(const char * p, const char * end) {
+    const char * nl = (const char *) memchr(p, '\n', end - p);
+    return nl ? nl + 1 : end;
+}
+
+// last newline in [p, end), nullptr if there is none, memrchr is not everywhere
+inline const char * last_newline(const char * p, const char * end) {
+    while (end > p)
+        if (*--end == '\n') return end;
+    return nullptr;
+}
+
+inline const char * parse_int(const char * p, const char * end, long long & out) {
+    const char * s = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    const char * digits = p;
+    long long value = 0;
+    while (p < end && (unsigned char) (*p - '0') < 10)
+        value = value * 10 + (*p++ - '0');
+    if (p == digits) return s;
+    out = negative ? -value : value;
+    return p;
+}
+
+inline const char * parse_float(const char * p, const char * end, float & out) {
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char * s = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+    // up to 19 significant digits fit in the mantissa, the rest only shift the exponent
+    unsigned long long mantissa = 0;
+    int exponent = 0, digits = 0;
+    const char * start = p;
+    while (p < end && (unsigned char) (*p - '0') < 10) {
+        if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); if (mantissa) digits++; }
+        else exponent++;
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && (unsigned char) (*p - '0') < 10) {
+            if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); if (mantissa) digits++; exponent--; }
+            p++;
+        }
+    }
+    if (p == start || (p == start + 1 && *start == '.')) return s;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        long long e;
+        const char * q = parse_int(p + 1, end, e);
+        if (q != p + 1) {
+            exponent += (int) e;
+            p = q;
+        }
+    }
+
+    double value = (double) mantissa;
+    int scale = exponent < 0 ? -exponent : exponent;
+    while (scale > 22) {
+        value = exponent < 0 ? value / 1e22 : value * 1e22;
+        scale -= 22;
+    }
+    value = exponent < 0 ? value / powers[scale] : value * powers[scale];
+    out = (float) (negative ? -value : value);
+    return p;
+}
+
+/*
+ * Formatting into a caller buffer, each returns the position after what it wrote
+ * format_float writes at most 16 characters, format_uint at most 10
+ */
+
+inline char * format_uint(char * out, unsigned int value) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = char('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (n) *out++ = digits[--n];
+    return out;
+}
+
+// 9 significant digits, enough to read back the same float, trailing zeros trimmed
+inline char * format_float(char * out, float value) {
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    if (value != value) { memcpy(out, "nan", 3); return out + 3; }
+    if (value < 0.0f) { *out++ = '-'; value = -value; }
+    if (value == 0.0f) { *out++ = '0'; return out; }
+    if (value > 3.4028235e38f) { memcpy(out, "inf", 3); return out + 3; }
+
+    // scale to a 9 digit integer mantissa
+    double v = value;
+    int exponent = (int) floor(log10(v));
+    int shift = 8 - exponent;
+    double scaled = v;
+    for (int s = shift; s != 0;) {
+        int step = s > 0 ? min(s, 22) : max(s, -22);
+        scaled = step > 0 ? scaled * powers[step] : scaled / powers[-step];
+        s -= step;
+    }
+    unsigned long long mantissa = (unsigned long long) (scaled + 0.5);
+    if (mantissa >= 1000000000ull) { mantissa /= 10; exponent++; }
+    else if (mantissa < 100000000ull) { mantissa *= 10; exponent--; }
+
+    char digits[9];
+    for (int i = 8; i >= 0; i--) {
+        digits[i] = char('0' + mantissa % 10);
+        mantissa /= 10;
+    }
+    int count = 9;
+    while (count > 1 && digits[count - 1] == '0') count--;
+
+    if (exponent >= 9 || exponent < -5) {
+        // d.ddde[-]xx
+        *out++ = digits[0];
+        if (count > 1) {
+            *out++ = '.';
+            for (int i = 1; i < count; i++) *out++ = digits[i];
+        }
+        *out++ = 'e';
+        if (exponent < 0) { *out++ = '-'; exponent = -exponent; }
+        return format_uint(out, (unsigned int) exponent);
+    }
+    if (exponent < 0) {
+        *out++ = '0';
+        *out++ = '.';
+        for (int i = -1; i > exponent; i--) *out++ = '0';
+        for (int i = 0; i < count; i++) *out++ = digits[i];
+        return out;
+    }
+    for (int i = 0; i <= exponent; i++) *out++ = i < count ? digits[i] : '0';
+    if (count > exponent + 1) {
+        *out++ = '.';
+        for (int i = exponent + 1; i < count; i++) *out++ = digits[i];
+    }
+    return out;
+}
+
+#endif //SIMPLIFICATION_TEXTPARSE_H
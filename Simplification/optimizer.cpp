@@ -0,0 +1,174 @@
+#include "optimizer.h"
+#include <cmath>
+#include <climits>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// simulated LRU cache, larger than real hardware as the algorithm suggests
+static const int CACHE_SIZE = 32;
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRI_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+// valences above share the score of the last entry
+static const unsigned int MAX_VALENCE = 32;
+
+float acmr(const unsigned int * indices, size_t index_count, size_t vertex_count, unsigned int cache_size) {
+    if (index_count < 3)
+        return 0.0f;
+    // a vertex is in the FIFO while fewer than cache_size misses happened since its own
+    vector<size_t> stamp(vertex_count, 0);
+    size_t misses = 0;
+    for (size_t i = 0; i < index_count; i++) {
+        unsigned int v = indices[i];
+        if (stamp[v] == 0 || misses - stamp[v] >= cache_size) {
+            misses++;
+            stamp[v] = misses;
+        }
+    }
+    return float(misses) / float(index_count / 3);
+}
+
+/*
+ * Every vertex gets a score from its position in the cache and the number of triangles still
+ * waiting for it, a triangle scores the sum of its vertices
+ * The best triangle touching the cache is emitted next, so only the cache neighbourhood is rescored
+ */
+CacheStats optimize_vertex_cache(unsigned int * indices, size_t index_count, size_t vertex_count) {
+    CacheStats stats;
+    stats.acmr_before = acmr(indices, index_count, vertex_count);
+    size_t face_count = index_count / 3;
+    if (face_count == 0) {
+        stats.acmr_after = stats.acmr_before;
+        return stats;
+    }
+
+    // score tables
+    float cache_score[CACHE_SIZE], valence_score[MAX_VALENCE + 1];
+    for (int i = 0; i < CACHE_SIZE; i++)
+        cache_score[i] = i < 3 ? LAST_TRI_SCORE : pow(1.0f - float(i - 3) / float(CACHE_SIZE - 3), CACHE_DECAY_POWER);
+    valence_score[0] = 0.0f;
+    for (unsigned int i = 1; i <= MAX_VALENCE; i++)
+        valence_score[i] = VALENCE_BOOST_SCALE * pow(float(i), -VALENCE_BOOST_POWER);
+
+    // triangles of each vertex, the first remaining[v] entries are not emitted yet
+    vector<unsigned int> remaining(vertex_count, 0), offsets(vertex_count + 1, 0), adjacency(index_count);
+    for (size_t i = 0; i < index_count; i++)
+        remaining[indices[i]]++;
+    for (size_t v = 0; v < vertex_count; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < index_count; i++)
+        adjacency[fill[indices[i]]++] = i / 3;
+
+    auto score_of = [&](int cache_pos, unsigned int valence) {
+        if (valence == 0) return 0.0f;
+        float score = cache_pos >= 0 ? cache_score[cache_pos] : 0.0f;
+        return score + valence_score[valence < MAX_VALENCE ? valence : MAX_VALENCE];
+    };
+
+    vector<float> vertex_score(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++)
+        vertex_score[v] = score_of(-1, remaining[v]);
+    vector<float> face_score(face_count);
+    vector<char> emitted(face_count, 0);
+    for (size_t f = 0; f < face_count; f++)
+        face_score[f] = vertex_score[indices[f * 3]] + vertex_score[indices[f * 3 + 1]] + vertex_score[indices[f * 3 + 2]];
+
+    vector<unsigned int> result(index_count);
+    unsigned int cache[CACHE_SIZE + 3], new_cache[CACHE_SIZE + 3];
+    int cache_count = 0;
+    size_t cursor = 0;
+    unsigned int best = UINT_MAX;
+
+    for (size_t out = 0; out < face_count; out++) {
+        // nothing touches the cache, take the next triangle in input order
+        if (best == UINT_MAX) {
+            while (emitted[cursor]) cursor++;
+            best = cursor;
+        }
+        const unsigned int * tri = indices + best * 3;
+        memcpy(&result[out * 3], tri, 3 * sizeof(unsigned int));
+        emitted[best] = 1;
+
+        // detach the triangle from its vertices
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = tri[k];
+            unsigned int * list = &adjacency[offsets[v]];
+            for (unsigned int j = 0; j < remaining[v]; j++) {
+                if (list[j] == best) {
+                    list[j] = list[remaining[v] - 1];
+                    remaining[v]--;
+                    break;
+                }
+            }
+        }
+
+        // triangle vertices go to the front, the rest keep their order
+        int new_count = 0;
+        for (int k = 0; k < 3; k++)
+            new_cache[new_count++] = tri[k];
+        for (int i = 0; i < cache_count; i++) {
+            unsigned int v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                new_cache[new_count++] = v;
+        }
+
+        // rescore the cache and the evicted vertices
+        for (int i = 0; i < new_count; i++) {
+            unsigned int v = new_cache[i];
+            int pos = i < CACHE_SIZE ? i : -1;
+            float score = score_of(pos, remaining[v]);
+            float delta = score - vertex_score[v];
+            vertex_score[v] = score;
+            for (unsigned int j = 0; j < remaining[v]; j++)
+                face_score[adjacency[offsets[v] + j]] += delta;
+        }
+
+        // best triangle touching the cache
+        best = UINT_MAX;
+        float best_score = -1.0f;
+        for (int i = 0; i < new_count && i < CACHE_SIZE; i++) {
+            unsigned int v = new_cache[i];
+            for (unsigned int j = 0; j < remaining[v]; j++) {
+                unsigned int f = adjacency[offsets[v] + j];
+                if (face_score[f] > best_score) {
+                    best_score = face_score[f];
+                    best = f;
+                }
+            }
+        }
+        cache_count = new_count < CACHE_SIZE ? new_count : CACHE_SIZE;
+        memcpy(cache, new_cache, cache_count * sizeof(unsigned int));
+    }
+
+    memcpy(indices, result.data(), face_count * 3 * sizeof(unsigned int));
+    stats.acmr_after = acmr(indices, index_count, vertex_count);
+    return stats;
+}
+
+size_t optimize_vertex_fetch(void * vertices, size_t vertex_count, size_t vertex_size, unsigned int * indices, size_t index_count) {
+    vector<unsigned int> remap(vertex_count, UINT_MAX);
+    vector<unsigned char> result(vertex_count * vertex_size);
+    unsigned char * data = (unsigned char *) vertices;
+
+    unsigned int count = 0;
+    for (size_t i = 0; i < index_count; i++) {
+        unsigned int v = indices[i];
+        if (remap[v] == UINT_MAX) {
+            remap[v] = count;
+            memcpy(&result[count * vertex_size], data + v * vertex_size, vertex_size);
+            count++;
+        }
+        indices[i] = remap[v];
+    }
+    // keep the unused ones after the used ones
+    size_t unused = count;
+    for (size_t v = 0; v < vertex_count; v++) {
+        if (remap[v] == UINT_MAX)
+            memcpy(&result[unused++ * vertex_size], data + v * vertex_size, vertex_size);
+    }
+    memcpy(data, result.data(), result.size());
+    return count;
+}
@@ -0,0 +1,23 @@
+#ifndef SIMPLIFICATION_OPTIMIZER_H
+#define SIMPLIFICATION_OPTIMIZER_H
+
+#include <cstddef>
+
+struct CacheStats {
+    // average cache miss ratio, transformed vertices per triangle
+    float acmr_before, acmr_after;
+};
+
+// ACMR of a triangle list on a FIFO post-transform cache
+float acmr(const unsigned int * indices, size_t index_count, size_t vertex_count, unsigned int cache_size = 16);
+
+// reorders the triangles in place for the post-transform vertex cache (Tom Forsyth's linear-speed algorithm)
+CacheStats optimize_vertex_cache(unsigned int * indices, size_t index_count, size_t vertex_count);
+
+/*
+ * Renumbers vertices in the order the index buffer first uses them and moves them accordingly,
+ * vertex_size bytes each, unused vertices end up past the returned count
+ */
+size_t optimize_vertex_fetch(void * vertices, size_t vertex_count, size_t vertex_size, unsigned int * indices, size_t index_count);
+
+#endif //SIMPLIFICATION_OPTIMIZER_H
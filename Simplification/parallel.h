@@ -0,0 +1,124 @@
+#ifndef SIMPLIFICATION_PARALLEL_H
+#define SIMPLIFICATION_PARALLEL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// number of threads worth starting for count items, small jobs stay on the calling thread
+inline unsigned int thread_count(size_t count, size_t grain = 1 << 14) {
+    unsigned int hardware = max(1u, thread::hardware_concurrency());
+    size_t useful = max(size_t(1), count / grain);
+    return (unsigned int) min(size_t(hardware), useful);
+}
+
+// runs fn(t) for every t in [0, threads), the calling thread takes t = 0
+template <typename F>
+void parallel_run(unsigned int threads, F fn) {
+    vector<thread> workers;
+    for (unsigned int t = 1; t < threads; t++)
+        workers.emplace_back(fn, t);
+    fn(0u);
+    for (thread & worker : workers)
+        worker.join();
+}
+
+// splits [0, count) into one contiguous range per thread, runs fn(t, begin, end)
+template <typename F>
+void parallel_for(size_t count, F fn, size_t grain = 1 << 14) {
+    unsigned int threads = thread_count(count, grain);
+    parallel_run(threads, [&](unsigned int t) {
+        fn(t, count * t / threads, count * (t + 1) / threads);
+    });
+}
+
+/*
+ * Runs fn(i) once for every task i in [0, costs.size()) on a pool of threads.
+ * Tasks are dealt largest cost first onto one deque per thread, each thread works its own deque from the front
+ * and, once empty, steals from the back of the others, so a few large tasks can not leave the pool idle
+ */
+template <typename F>
+void parallel_tasks(const vector<size_t> & costs, F fn) {
+    struct TaskQueue {
+        mutex guard;
+        deque<size_t> tasks;
+    };
+    vector<size_t> order(costs.size());
+    iota(order.begin(), order.end(), size_t(0));
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return costs[a] > costs[b]; });
+    unsigned int threads = (unsigned int) min(size_t(max(1u, thread::hardware_concurrency())), max(size_t(1), costs.size()));
+    vector<TaskQueue> queues(threads);
+    for (size_t k = 0; k < order.size(); k++)
+        queues[k % threads].tasks.push_back(order[k]);
+
+    parallel_run(threads, [&](unsigned int t) {
+        while (true) {
+            size_t task = 0;
+            bool found = false;
+            for (unsigned int s = 0; s < threads && !found; s++) {
+                TaskQueue & queue = queues[(t + s) % threads];
+                lock_guard<mutex> lock(queue.guard);
+                if (queue.tasks.empty()) continue;
+                // own queue from the largest end, stolen work from the smallest
+                if (s == 0) {
+                    task = queue.tasks.front();
+                    queue.tasks.pop_front();
+                }
+                else {
+                    task = queue.tasks.back();
+                    queue.tasks.pop_back();
+                }
+                found = true;
+            }
+            // no task is ever added, so empty queues everywhere means done
+            if (!found) return;
+            fn(task);
+        }
+    });
+}
+
+// bounded FIFO between producer and consumer threads, push blocks while full, pop blocks while empty
+template <typename T>
+class BlockingQueue {
+public:
+    explicit BlockingQueue(size_t capacity) : capacity(capacity) {}
+
+    void push(T item) {
+        unique_lock<mutex> lock(guard);
+        not_full.wait(lock, [&] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+    }
+
+    // no more pushes, pop returns false once the queue drained
+    void close() {
+        lock_guard<mutex> lock(guard);
+        closed = true;
+        not_empty.notify_all();
+    }
+
+    bool pop(T & item) {
+        unique_lock<mutex> lock(guard);
+        not_empty.wait(lock, [&] { return !items.empty() || closed; });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+private:
+    size_t capacity;
+    bool closed = false;
+    deque<T> items;
+    mutex guard;
+    condition_variable not_full, not_empty;
+};
+
+#endif //SIMPLIFICATION_PARALLEL_H
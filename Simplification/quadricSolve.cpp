@@ -0,0 +1,73 @@
+#include "quadricSolve.h"
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// below this |det(A)| the quadric is taken as rank deficient, A is a sum of unit normal products
+static const float DET_EPSILON = 1e-3f;
+
+void QuadricBatch::reserve(size_t n) {
+    for (vector<float> * v : {&a00, &a01, &a02, &a11, &a12, &a22, &b0, &b1, &b2, &mx, &my, &mz})
+        v->reserve(n);
+}
+
+void QuadricBatch::push(const glm::mat4 & Q, glm::vec3 average) {
+    a00.push_back(Q[0][0]); a01.push_back(Q[0][1]); a02.push_back(Q[0][2]);
+    a11.push_back(Q[1][1]); a12.push_back(Q[1][2]); a22.push_back(Q[2][2]);
+    b0.push_back(Q[3][0]); b1.push_back(Q[3][1]); b2.push_back(Q[3][2]);
+    mx.push_back(average.x); my.push_back(average.y); mz.push_back(average.z);
+}
+
+/*
+ * Cramer's rule with the cofactors of the symmetric A
+ * p = -adj(A) b / det(A)
+ */
+void QuadricBatch::solve() {
+    size_t n = size(), i = 0;
+    x.resize(n); y.resize(n); z.resize(n);
+
+#ifdef __SSE2__
+    const __m128 eps = _mm_set1_ps(DET_EPSILON), sign = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= n; i += 4) {
+        __m128 m00 = _mm_loadu_ps(&a00[i]), m01 = _mm_loadu_ps(&a01[i]), m02 = _mm_loadu_ps(&a02[i]);
+        __m128 m11 = _mm_loadu_ps(&a11[i]), m12 = _mm_loadu_ps(&a12[i]), m22 = _mm_loadu_ps(&a22[i]);
+        __m128 v0 = _mm_loadu_ps(&b0[i]), v1 = _mm_loadu_ps(&b1[i]), v2 = _mm_loadu_ps(&b2[i]);
+        // cofactors
+        __m128 c00 = _mm_sub_ps(_mm_mul_ps(m11, m22), _mm_mul_ps(m12, m12));
+        __m128 c01 = _mm_sub_ps(_mm_mul_ps(m02, m12), _mm_mul_ps(m01, m22));
+        __m128 c02 = _mm_sub_ps(_mm_mul_ps(m01, m12), _mm_mul_ps(m02, m11));
+        __m128 c11 = _mm_sub_ps(_mm_mul_ps(m00, m22), _mm_mul_ps(m02, m02));
+        __m128 c12 = _mm_sub_ps(_mm_mul_ps(m01, m02), _mm_mul_ps(m00, m12));
+        __m128 c22 = _mm_sub_ps(_mm_mul_ps(m00, m11), _mm_mul_ps(m01, m01));
+        __m128 det = _mm_add_ps(_mm_mul_ps(m00, c00), _mm_add_ps(_mm_mul_ps(m01, c01), _mm_mul_ps(m02, c02)));
+        // lanes with a singular A divide by ~0 here, they are replaced below
+        __m128 inv = _mm_div_ps(_mm_set1_ps(-1.0f), det);
+        __m128 px = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(c00, v0), _mm_add_ps(_mm_mul_ps(c01, v1), _mm_mul_ps(c02, v2))), inv);
+        __m128 py = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(c01, v0), _mm_add_ps(_mm_mul_ps(c11, v1), _mm_mul_ps(c12, v2))), inv);
+        __m128 pz = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(c02, v0), _mm_add_ps(_mm_mul_ps(c12, v1), _mm_mul_ps(c22, v2))), inv);
+        // rank deficiency fallback, blend in the average position
+        __m128 ok = _mm_cmpge_ps(_mm_andnot_ps(sign, det), eps);
+        _mm_storeu_ps(&x[i], _mm_or_ps(_mm_and_ps(ok, px), _mm_andnot_ps(ok, _mm_loadu_ps(&mx[i]))));
+        _mm_storeu_ps(&y[i], _mm_or_ps(_mm_and_ps(ok, py), _mm_andnot_ps(ok, _mm_loadu_ps(&my[i]))));
+        _mm_storeu_ps(&z[i], _mm_or_ps(_mm_and_ps(ok, pz), _mm_andnot_ps(ok, _mm_loadu_ps(&mz[i]))));
+    }
+#endif
+
+    // remaining lanes, or the whole batch where SSE is not available (left to the auto-vectorizer)
+    for (; i < n; i++) {
+        float c00 = a11[i] * a22[i] - a12[i] * a12[i];
+        float c01 = a02[i] * a12[i] - a01[i] * a22[i];
+        float c02 = a01[i] * a12[i] - a02[i] * a11[i];
+        float c11 = a00[i] * a22[i] - a02[i] * a02[i];
+        float c12 = a01[i] * a02[i] - a00[i] * a12[i];
+        float c22 = a00[i] * a11[i] - a01[i] * a01[i];
+        float det = a00[i] * c00 + a01[i] * c01 + a02[i] * c02;
+        bool ok = fabs(det) >= DET_EPSILON;
+        float inv = ok ? -1.0f / det : 0.0f;
+        x[i] = ok ? (c00 * b0[i] + c01 * b1[i] + c02 * b2[i]) * inv : mx[i];
+        y[i] = ok ? (c01 * b0[i] + c11 * b1[i] + c12 * b2[i]) * inv : my[i];
+        z[i] = ok ? (c02 * b0[i] + c12 * b1[i] + c22 * b2[i]) * inv : mz[i];
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef SIMPLIFICATION_QUADRICSOLVE_H
+#define SIMPLIFICATION_QUADRICSOLVE_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+using namespace std;
+
+/*
+ * Summed quadrics of many clusters in SoA form
+ * Each quadric is solved for the point minimizing its error, A p = -b,
+ * with A the upper 3x3 block and b the last column
+ * A rank deficient quadric falls back to the average position of the cluster
+ */
+class QuadricBatch {
+public:
+    void reserve(size_t n);
+    void push(const glm::mat4 & Q, glm::vec3 average);
+    size_t size() const { return a00.size(); }
+
+    // solve every quadric, four lanes at a time
+    void solve();
+    glm::vec3 position(size_t i) const { return glm::vec3(x[i], y[i], z[i]); }
+
+private:
+    // symmetric A
+    vector<float> a00, a01, a02, a11, a12, a22;
+    // b
+    vector<float> b0, b1, b2;
+    // average position, the fallback
+    vector<float> mx, my, mz;
+    // solution
+    vector<float> x, y, z;
+};
+
+#endif //SIMPLIFICATION_QUADRICSOLVE_H
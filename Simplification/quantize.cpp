@@ -0,0 +1,78 @@
+#include "quantize.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include <cfloat>
+#include <cmath>
+
+static unsigned short unorm16(float v) {
+    return (unsigned short) lround(glm::clamp(v, 0.0f, 1.0f) * 65535.0f);
+}
+
+static short snorm16(float v) {
+    return (short) lround(glm::clamp(v, -1.0f, 1.0f) * 32767.0f);
+}
+
+glm::vec2 oct_encode(glm::vec3 n) {
+    float l1 = fabs(n.x) + fabs(n.y) + fabs(n.z);
+    if (l1 == 0.0f)
+        return glm::vec2(0.0f);
+    glm::vec2 e = glm::vec2(n.x, n.y) / l1;
+    // fold the lower hemisphere over the diagonals
+    if (n.z < 0.0f) {
+        glm::vec2 folded = 1.0f - glm::abs(glm::vec2(e.y, e.x));
+        e.x = e.x >= 0.0f ? folded.x : -folded.x;
+        e.y = e.y >= 0.0f ? folded.y : -folded.y;
+    }
+    return e;
+}
+
+glm::vec3 oct_decode(glm::vec2 e) {
+    glm::vec3 n(e.x, e.y, 1.0f - fabs(e.x) - fabs(e.y));
+    if (n.z < 0.0f) {
+        glm::vec2 folded = 1.0f - glm::abs(glm::vec2(n.y, n.x));
+        n.x = n.x >= 0.0f ? folded.x : -folded.x;
+        n.y = n.y >= 0.0f ? folded.y : -folded.y;
+    }
+    return glm::normalize(n);
+}
+
+/*
+ * 16 bytes per vertex instead of 32
+ * Positions are stored relative to the bounding box of the vertices with one scale for all axes, the longest extent.
+ * The decode matrix undoes it, a uniform scale keeps normals valid under it without the inverse transpose
+ */
+QuantizedMesh quantize(const vector<Vertex> & vertices, const vector<unsigned int> & indices) {
+    QuantizedMesh result;
+    result.indices = indices;
+
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+    for (const Vertex & v : vertices) {
+        min = glm::min(min, v.Position);
+        max = glm::max(max, v.Position);
+    }
+    if (vertices.empty())
+        min = max = glm::vec3(0.0f);
+    glm::vec3 size = max - min;
+    float extent = glm::max(size.x, glm::max(size.y, size.z));
+    // a single point keeps a unit extent so the scale stays invertible
+    if (extent <= 0.0f) extent = 1.0f;
+
+    result.vertices.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const Vertex & v = vertices[i];
+        QuantizedVertex & q = result.vertices[i];
+        glm::vec3 p = (v.Position - min) / extent;
+        q.position[0] = unorm16(p.x);
+        q.position[1] = unorm16(p.y);
+        q.position[2] = unorm16(p.z);
+        q.padding = 0;
+        glm::vec2 n = oct_encode(v.Normal);
+        q.normal[0] = snorm16(n.x);
+        q.normal[1] = snorm16(n.y);
+        q.tex_coords[0] = glm::packHalf1x16(v.TexCoords.x);
+        q.tex_coords[1] = glm::packHalf1x16(v.TexCoords.y);
+    }
+
+    result.decode = glm::scale(glm::translate(glm::mat4(1.0f), min), glm::vec3(extent));
+    return result;
+}
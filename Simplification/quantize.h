@@ -0,0 +1,32 @@
+#ifndef SIMPLIFICATION_QUANTIZE_H
+#define SIMPLIFICATION_QUANTIZE_H
+
+#include "model/meshData.h"
+
+struct QuantizedVertex {
+    // position, unorm16 inside the bounding box scaled by its longest extent
+    unsigned short position[3];
+    // keeps the stride at 16 bytes, vertex fetch and glTF want 4 byte aligned strides
+    unsigned short padding;
+    // octahedral encoded normal, snorm16
+    short normal[2];
+    // half float texture coords
+    unsigned short tex_coords[2];
+};
+
+static_assert(sizeof(QuantizedVertex) == 16, "QuantizedVertex should be 16 bytes");
+
+struct QuantizedMesh {
+    vector<QuantizedVertex> vertices;
+    vector<unsigned int> indices;
+    // maps unorm positions in [0, 1] back to model space, apply before the model matrix
+    glm::mat4 decode;
+};
+
+QuantizedMesh quantize(const vector<Vertex> & vertices, const vector<unsigned int> & indices);
+
+// octahedral mapping of a unit normal into [-1, 1]^2 and back
+glm::vec2 oct_encode(glm::vec3 n);
+glm::vec3 oct_decode(glm::vec2 e);
+
+#endif //SIMPLIFICATION_QUANTIZE_H
@@ -0,0 +1,325 @@
+#include "scene.h"
+#include "parallel.h"
+#include "model/model.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <unordered_map>
+
+// centroid, RMS distance to it and the largest absolute coordinate of a mesh
+struct MeshFrame {
+    glm::dvec3 centroid;
+    double radius;
+    float reach;
+};
+
+static MeshFrame mesh_frame(const MeshData & mesh) {
+    MeshFrame frame {glm::dvec3(0.0), 0.0, 0.0f};
+    if (mesh.vertices.empty()) return frame;
+    for (const Vertex & vertex : mesh.vertices) {
+        frame.centroid += glm::dvec3(vertex.Position);
+        glm::vec3 a = glm::abs(vertex.Position);
+        frame.reach = glm::max(frame.reach, glm::max(a.x, glm::max(a.y, a.z)));
+    }
+    frame.centroid /= (double) mesh.vertices.size();
+    for (const Vertex & vertex : mesh.vertices) {
+        glm::dvec3 d = glm::dvec3(vertex.Position) - frame.centroid;
+        frame.radius += glm::dot(d, d);
+    }
+    frame.radius = sqrt(frame.radius / (double) mesh.vertices.size());
+    return frame;
+}
+
+// vertex count and indices, unchanged by any placement
+static size_t topology_hash(const MeshData & mesh) {
+    size_t h = mesh.vertices.size();
+    for (unsigned int index : mesh.indices)
+        h = h * 0x9E3779B97F4A7C15ull + index;
+    return h ^ (h >> 29);
+}
+
+// eigenvector of the largest eigenvalue of a symmetric 4x4 matrix, cyclic Jacobi rotations
+static glm::dvec4 largest_eigenvector(double A[4][4]) {
+    double V[4][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+    for (int sweep = 0; sweep < 50; sweep++) {
+        double off = 0.0, diagonal = 0.0;
+        for (int p = 0; p < 4; p++) {
+            diagonal += A[p][p] * A[p][p];
+            for (int q = p + 1; q < 4; q++)
+                off += A[p][q] * A[p][q];
+        }
+        if (off <= 1e-30 * diagonal) break;
+        for (int p = 0; p < 4; p++)
+            for (int q = p + 1; q < 4; q++) {
+                if (A[p][q] == 0.0) continue;
+                double theta = (A[q][q] - A[p][p]) / (2.0 * A[p][q]);
+                double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+                double c = 1.0 / sqrt(t * t + 1.0), s = t * c;
+                for (int k = 0; k < 4; k++) {
+                    double kp = A[k][p], kq = A[k][q];
+                    A[k][p] = c * kp - s * kq;
+                    A[k][q] = s * kp + c * kq;
+                }
+                for (int k = 0; k < 4; k++) {
+                    double pk = A[p][k], qk = A[q][k];
+                    A[p][k] = c * pk - s * qk;
+                    A[q][k] = s * pk + c * qk;
+                }
+                for (int k = 0; k < 4; k++) {
+                    double kp = V[k][p], kq = V[k][q];
+                    V[k][p] = c * kp - s * kq;
+                    V[k][q] = s * kp + c * kq;
+                }
+            }
+    }
+    int best = 0;
+    for (int k = 1; k < 4; k++)
+        if (A[k][k] > A[best][best]) best = k;
+    return glm::dvec4(V[0][best], V[1][best], V[2][best], V[3][best]);
+}
+
+/*
+ * Similarity transform taking the vertices of a onto the same numbered vertices of b,
+ * Horn's closed form: the rotation quaternion from the cross covariance, the scale from the RMS radii
+ */
+static glm::mat4 similarity(const MeshData & a, const MeshFrame & fa, const MeshData & b, const MeshFrame & fb) {
+    double S[3][3] = {};
+    for (size_t v = 0; v < a.vertices.size(); v++) {
+        glm::dvec3 p = glm::dvec3(a.vertices[v].Position) - fa.centroid;
+        glm::dvec3 q = glm::dvec3(b.vertices[v].Position) - fb.centroid;
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+                S[i][j] += p[i] * q[j];
+    }
+    double N[4][4] = {
+        {S[0][0] + S[1][1] + S[2][2], S[1][2] - S[2][1], S[2][0] - S[0][2], S[0][1] - S[1][0]},
+        {S[1][2] - S[2][1], S[0][0] - S[1][1] - S[2][2], S[0][1] + S[1][0], S[2][0] + S[0][2]},
+        {S[2][0] - S[0][2], S[0][1] + S[1][0], S[1][1] - S[0][0] - S[2][2], S[1][2] + S[2][1]},
+        {S[0][1] - S[1][0], S[2][0] + S[0][2], S[1][2] + S[2][1], S[2][2] - S[0][0] - S[1][1]}
+    };
+    glm::dvec4 e = largest_eigenvector(N);
+    double w = e[0], x = e[1], y = e[2], z = e[3];
+    // column major, columns are the images of the axes
+    glm::dmat3 R(1 - 2 * (y * y + z * z), 2 * (x * y + w * z), 2 * (x * z - w * y),
+                 2 * (x * y - w * z), 1 - 2 * (x * x + z * z), 2 * (y * z + w * x),
+                 2 * (x * z + w * y), 2 * (y * z - w * x), 1 - 2 * (x * x + y * y));
+    double scale = fa.radius > 0.0 ? fb.radius / fa.radius : 1.0;
+    glm::dmat3 M = R * scale;
+    glm::dvec3 t = fb.centroid - M * fa.centroid;
+    glm::mat4 transform = glm::mat4(glm::mat3(M));
+    transform[3] = glm::vec4(glm::vec3(t), 1.0f);
+    return transform;
+}
+
+vector<MeshInstance> find_instances(const vector<const MeshData *> & meshes, float tolerance) {
+    size_t num_meshes = meshes.size();
+    vector<size_t> hashes(num_meshes), costs(num_meshes);
+    vector<MeshFrame> frames(num_meshes);
+    for (size_t i = 0; i < num_meshes; i++)
+        costs[i] = meshes[i]->vertices.size() + meshes[i]->indices.size();
+    parallel_tasks(costs, [&](size_t i) {
+        hashes[i] = topology_hash(*meshes[i]);
+        frames[i] = mesh_frame(*meshes[i]);
+    });
+
+    auto same_shape = [&](size_t a, size_t b, glm::mat4 & transform) {
+        const MeshData & A = *meshes[a], & B = *meshes[b];
+        if (A.vertices.size() != B.vertices.size() || A.indices != B.indices)
+            return false;
+        bool exact = true;
+        for (size_t v = 0; v < A.vertices.size() && exact; v++)
+            exact = A.vertices[v].Position == B.vertices[v].Position;
+        if (exact) {
+            transform = glm::mat4(1.0f);
+            return true;
+        }
+        transform = similarity(A, frames[a], B, frames[b]);
+        // float spacing grows with the distance from the origin, far copies round differently
+        float scale = frames[a].radius > 0.0 ? float(frames[b].radius / frames[a].radius) : 1.0f;
+        float reach = glm::max(frames[b].reach, frames[a].reach * scale);
+        float limit = glm::max(tolerance * float(frames[b].radius), 16.0f * FLT_EPSILON * reach);
+        for (size_t v = 0; v < A.vertices.size(); v++) {
+            glm::vec3 p = glm::vec3(transform * glm::vec4(A.vertices[v].Position, 1.0f));
+            if (glm::length(p - B.vertices[v].Position) > limit)
+                return false;
+        }
+        return true;
+    };
+    // candidates share the topology hash, the first mesh of a shape is its source
+    vector<MeshInstance> instances(num_meshes);
+    unordered_map<size_t, vector<size_t>> sources;
+    for (size_t i = 0; i < num_meshes; i++) {
+        instances[i] = MeshInstance {i, glm::mat4(1.0f)};
+        if (meshes[i]->vertices.empty()) continue;
+        vector<size_t> & candidates = sources[hashes[i]];
+        for (size_t s : candidates) {
+            glm::mat4 transform;
+            if (same_shape(s, i, transform)) {
+                instances[i] = MeshInstance {s, transform};
+                break;
+            }
+        }
+        if (instances[i].source == i)
+            candidates.push_back(i);
+    }
+    return instances;
+}
+
+// source result placed onto a copy, normals only turn as the scale is uniform
+static MeshData placed_copy(const MeshData & source, const glm::mat4 & transform) {
+    MeshData copy = source;
+    glm::mat3 rotation(transform);
+    for (Vertex & vertex : copy.vertices) {
+        vertex.Position = glm::vec3(transform * glm::vec4(vertex.Position, 1.0f));
+        vertex.Normal = glm::normalize(rotation * vertex.Normal);
+    }
+    return copy;
+}
+
+// fn(ms, i) simplifies source mesh i, the results of copies stay empty
+template <typename F>
+static vector<MeshData> run_sources(const vector<const MeshData *> & meshes, const vector<MeshInstance> & instances,
+                                    const OutputOptions & options, F fn) {
+    vector<MeshData> results(meshes.size());
+    vector<size_t> costs(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++)
+        costs[i] = instances[i].source == i ? meshes[i]->indices.size() / 3 : 0;
+    parallel_tasks(costs, [&](size_t i) {
+        if (instances[i].source != i || meshes[i]->vertices.empty()) return;
+        MeshSimple ms(*meshes[i]);
+        fn(ms, i);
+        results[i] = ms.out_data(options);
+    });
+    return results;
+}
+
+static void share_instances(const vector<MeshInstance> & instances, vector<MeshData> & results) {
+    for (size_t i = 0; i < results.size(); i++)
+        if (instances[i].source != i)
+            results[i] = placed_copy(results[instances[i].source], instances[i].transform);
+}
+
+static vector<MeshData> decimate_sources(const vector<const MeshData *> & meshes, const vector<MeshInstance> & instances,
+                                         float dec_per, const OutputOptions & options) {
+    return run_sources(meshes, instances, options, [&](MeshSimple & ms, size_t) { ms.decimate(dec_per); });
+}
+
+vector<MeshData> simplify_meshes(const vector<const MeshData *> & meshes, float dec_per, const OutputOptions & options) {
+    vector<MeshInstance> instances = find_instances(meshes);
+    vector<MeshData> results = decimate_sources(meshes, instances, dec_per, options);
+    share_instances(instances, results);
+    return results;
+}
+
+static vector<const MeshData *> model_meshes(const Model & model) {
+    vector<const MeshData *> meshes;
+    for (const Mesh & mesh : model.meshes)
+        meshes.push_back(&mesh);
+    return meshes;
+}
+
+static void upload(Model & model, const vector<MeshInstance> & instances, vector<MeshData> & results) {
+    // buffer uploads need the OpenGL context, which only this thread has, sources always come before their copies
+    for (size_t i = 0; i < results.size(); i++) {
+        const MeshInstance & instance = instances[i];
+        if (instance.source == i)
+            model.meshes[i] = Mesh(std::move(results[i]));
+        // exact copies draw from the buffers of their source
+        else if (instance.transform == glm::mat4(1.0f))
+            model.meshes[i] = model.meshes[instance.source];
+        else
+            model.meshes[i] = Mesh(placed_copy(model.meshes[instance.source], instance.transform));
+    }
+}
+
+void simplify_model(Model & model, float dec_per, const OutputOptions & options) {
+    vector<const MeshData *> meshes = model_meshes(model);
+    vector<MeshInstance> instances = find_instances(meshes);
+    vector<MeshData> results = decimate_sources(meshes, instances, dec_per, options);
+    upload(model, instances, results);
+}
+
+static vector<MeshData> budget_sources(const vector<const MeshData *> & meshes, const vector<MeshInstance> & instances,
+                                       size_t triangle_budget, const OutputOptions & options) {
+    // a source counts once for each of its copies
+    vector<size_t> costs(meshes.size(), 0), weights(meshes.size(), 0);
+    size_t total = 0;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        weights[instances[i].source]++;
+        total += meshes[i]->indices.size() / 3;
+    }
+    for (size_t i = 0; i < meshes.size(); i++)
+        if (weights[i]) costs[i] = meshes[i]->indices.size() / 3;
+
+    // full profile of every source mesh
+    vector<vector<DecimateStep>> profiles(meshes.size());
+    if (total > triangle_budget)
+        parallel_tasks(costs, [&](size_t i) {
+            if (!weights[i] || meshes[i]->vertices.empty()) return;
+            MeshSimple ms(*meshes[i]);
+            profiles[i] = ms.decimate_profile(0.0f);
+            // flat parts collapse for free down to nothing, a mesh only vanishes when all else is spent
+            for (DecimateStep & step : profiles[i])
+                if (step.faces == 0) step.error = FLT_MAX;
+        });
+
+    // smallest merged error whose collapses bring the total within the budget
+    vector<float> errors;
+    for (const vector<DecimateStep> & profile : profiles)
+        for (const DecimateStep & step : profile)
+            errors.push_back(step.error);
+    sort(errors.begin(), errors.end());
+    errors.erase(unique(errors.begin(), errors.end()), errors.end());
+    auto faces_at = [&](size_t i, size_t count) {
+        return (count ? profiles[i][count - 1].faces : costs[i]) * weights[i];
+    };
+    // collapses of mesh i with an error below the threshold, profiles never decrease
+    auto steps_below = [&](size_t i, float threshold) {
+        return size_t(lower_bound(profiles[i].begin(), profiles[i].end(), threshold,
+                                  [](const DecimateStep & s, float e) { return s.error < e; }) - profiles[i].begin());
+    };
+    auto total_below = [&](float threshold) {
+        size_t sum = 0;
+        for (size_t i = 0; i < meshes.size(); i++)
+            sum += faces_at(i, steps_below(i, threshold));
+        return sum;
+    };
+    // first error whose cheaper collapses fit the budget, the error before it has to be taken in part
+    size_t low = 0, high = errors.size();
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (total_below(errors[mid]) > triangle_budget) low = mid + 1;
+        else high = mid;
+    }
+    vector<size_t> counts(meshes.size(), 0);
+    if (low > 0) {
+        // everything cheaper than errors[low - 1], then collapses at exactly that error until the budget holds
+        float threshold = errors[low - 1];
+        size_t sum = total_below(threshold);
+        for (size_t i = 0; i < meshes.size(); i++) {
+            counts[i] = steps_below(i, threshold);
+            sum -= faces_at(i, counts[i]);
+            while (counts[i] < profiles[i].size() && profiles[i][counts[i]].error == threshold &&
+                   sum + faces_at(i, counts[i]) > triangle_budget)
+                counts[i]++;
+            sum += faces_at(i, counts[i]);
+        }
+    }
+
+    return run_sources(meshes, instances, options, [&](MeshSimple & ms, size_t i) { ms.decimate_steps(counts[i]); });
+}
+
+vector<MeshData> simplify_meshes_budget(const vector<const MeshData *> & meshes, size_t triangle_budget,
+                                        const OutputOptions & options) {
+    vector<MeshInstance> instances = find_instances(meshes);
+    vector<MeshData> results = budget_sources(meshes, instances, triangle_budget, options);
+    share_instances(instances, results);
+    return results;
+}
+
+void simplify_model_budget(Model & model, size_t triangle_budget, const OutputOptions & options) {
+    vector<const MeshData *> meshes = model_meshes(model);
+    vector<MeshInstance> instances = find_instances(meshes);
+    vector<MeshData> results = budget_sources(meshes, instances, triangle_budget, options);
+    upload(model, instances, results);
+}
@@ -0,0 +1,51 @@
+#ifndef SIMPLIFICATION_SCENE_H
+#define SIMPLIFICATION_SCENE_H
+
+#include "simplification.h"
+
+class Model;
+
+struct MeshInstance {
+    // first mesh of the same shape, the mesh itself when it is the first
+    size_t source;
+    // rotation, uniform scale and translation from the source to this mesh, identity for an exact copy
+    glm::mat4 transform;
+};
+
+/*
+ * Finds meshes that are copies of an earlier one placed with a different transform,
+ * as CAD exports repeat bolts and fixtures.
+ * Candidates are hashed on vertex count and indices, which no transform changes, so corresponding vertices
+ * are known and the transform between two candidates is solved in closed form rather than guessed from
+ * principal axes, which are ambiguous for symmetric parts. Mirrored copies are not matched.
+ * A candidate is a copy when every transformed vertex lands within tolerance times the RMS radius,
+ * or a few float steps for meshes far from the origin
+ */
+vector<MeshInstance> find_instances(const vector<const MeshData *> & meshes, float tolerance = 1e-5f);
+
+/*
+ * Decimates every mesh to dec_per of its vertices, see MeshSimple::decimate.
+ * Meshes run concurrently, balanced by face count with parallel_tasks, results keep the input order.
+ * Each shape of find_instances is simplified once, its copies get the result transformed into place
+ */
+vector<MeshData> simplify_meshes(const vector<const MeshData *> & meshes, float dec_per,
+                                 const OutputOptions & options = OutputOptions());
+
+// simplify_meshes over all meshes of the model, the results are uploaded on the calling thread,
+// exact copies share the buffers of their source
+void simplify_model(Model & model, float dec_per, const OutputOptions & options = OutputOptions());
+
+/*
+ * Simplifies the meshes to at most triangle_budget triangles in total, spent where it buys the most.
+ * Every mesh records its decimate profile in parallel, the profiles are merged by error and one threshold is
+ * chosen so the total fits, then each mesh replays its collapses up to the threshold.
+ * Copies found by find_instances are profiled once, their faces counting once per copy.
+ * Simple meshes go far below a fixed ratio and detailed ones keep more, for the same total
+ */
+vector<MeshData> simplify_meshes_budget(const vector<const MeshData *> & meshes, size_t triangle_budget,
+                                        const OutputOptions & options = OutputOptions());
+
+// simplify_meshes_budget over all meshes of the model, uploaded as in simplify_model
+void simplify_model_budget(Model & model, size_t triangle_budget, const OutputOptions & options = OutputOptions());
+
+#endif //SIMPLIFICATION_SCENE_H
@@ -1,19 +1,96 @@
 #include "simplification.h"
+#include "quadricSolve.h"
+#include "parallel.h"
 #include <cfloat>
+#include <cstdint>
+#include <cmath>
 #include <queue>
 #include <map>
+#include <unordered_set>
+
+const unsigned int CellMap::NONE;
+const size_t CellMap::DEFAULT_BUDGET;
+
+CellMap::CellMap(int nx, int ny, int nz, size_t budget) : nx(nx), ny(ny) {
+    size_t num = size_t(nx) * size_t(ny) * size_t(nz);
+    if (num <= budget / sizeof(unsigned int))
+        dense.assign(num, NONE);
+}
+
+unsigned int & CellMap::slot(const Pos & pos) {
+    if (!dense.empty())
+        return dense[(size_t(pos.z) * size_t(ny) + size_t(pos.y)) * size_t(nx) + size_t(pos.x)];
+    return sparse.insert(pair<Pos, unsigned int>{pos, NONE}).first->second;
+}
+
+struct FaceKey {
+    // sorted vertex indices, all UINT_MAX for a face to skip, which sorting leaves in v[2]
+    unsigned int v[3];
+    bool operator==(const FaceKey & k) const {
+        return v[0] == k.v[0] && v[1] == k.v[1] && v[2] == k.v[2];
+    }
+};
+
+struct FaceKeyHash {
+    size_t operator()(const FaceKey & k) const {
+        size_t h = k.v[0];
+        h = h * 0x9E3779B97F4A7C15ull + k.v[1];
+        h = h * 0x9E3779B97F4A7C15ull + k.v[2];
+        return h ^ (h >> 29);
+    }
+};
+
+/*
+ * Finding faces with the same three vertices as an earlier face, whatever the winding,
+ * so duplicates and opposite-duplicates both go
+ * Keys are hashed once into one bucket per thread, every thread then dedups its bucket on its own.
+ * Buckets list their faces in order, which keeps the first copy and gives the same result for any number of threads
+ */
+static vector<char> duplicate_faces(vector<FaceKey> & keys) {
+    // sort the triples, partition by hash, each range fills its own row of buckets so no locks are needed
+    unsigned int threads = thread_count(keys.size());
+    vector<vector<vector<unsigned int>>> buckets(threads, vector<vector<unsigned int>>(threads));
+    parallel_run(threads, [&](unsigned int t) {
+        FaceKeyHash hash;
+        size_t begin = keys.size() * t / threads, end = keys.size() * (t + 1) / threads;
+        for (size_t i = begin; i < end; i++) {
+            unsigned int * v = keys[i].v;
+            if (v[0] > v[1]) swap(v[0], v[1]);
+            if (v[1] > v[2]) swap(v[1], v[2]);
+            if (v[0] > v[1]) swap(v[0], v[1]);
+            if (v[2] != UINT_MAX)
+                buckets[t][hash(keys[i]) % threads].push_back((unsigned int) i);
+        }
+    });
+
+    vector<char> duplicate(keys.size(), 0);
+    parallel_run(threads, [&](unsigned int t) {
+        size_t count = 0;
+        for (unsigned int r = 0; r < threads; r++)
+            count += buckets[r][t].size();
+        unordered_set<FaceKey, FaceKeyHash> seen;
+        seen.reserve(count);
+        // rows in range order, so faces come in input order
+        for (unsigned int r = 0; r < threads; r++)
+            for (unsigned int i : buckets[r][t])
+                if (!seen.insert(keys[i]).second)
+                    duplicate[i] = 1;
+    });
+    return duplicate;
+}
 
 /*
  * Only Collecting Vertex Position and Face Indices From Mesh
  * Then Building the Face Normal
  */
-MeshSimple::MeshSimple(const Mesh &mesh) {
+MeshSimple::MeshSimple(const MeshData & mesh) {
     // collecting vertex information
     for (const Vertex & vertex : mesh.vertices) {
         Vert vert;
         vert.valid = true;
         vert.position = vertex.Position;
         vert.normal = glm::vec3(0.0f);
+        vert.locked = false;
         this->vertices.push_back(vert);
     }
     // collecting faces information, and updating vertex information
@@ -37,6 +114,46 @@ MeshSimple::MeshSimple(const Mesh &mesh) {
     }
 }
 
+MeshSimple::MeshSimple(const MeshCache & cache) {
+    if (!cache.has_state()) {
+        *this = MeshSimple(cache.data());
+        return;
+    }
+    const Vertex * vertex = cache.vertices();
+    const unsigned int * indices = cache.indices();
+    const unsigned int * offsets = cache.adjacency_offsets();
+    const unsigned int * adjacency = cache.adjacency_faces();
+    const glm::vec4 * planes = cache.face_planes();
+    vertices.resize(cache.vertex_count());
+    faces.resize(cache.face_count());
+    parallel_for(vertices.size(), [&](unsigned int, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Vert & vert = vertices[i];
+            vert.valid = true;
+            vert.position = vertex[i].Position;
+            vert.normal = glm::vec3(0.0f);
+            vert.locked = false;
+            vert.connected_faces.assign(adjacency + offsets[i], adjacency + offsets[i + 1]);
+        }
+    });
+    parallel_for(faces.size(), [&](unsigned int, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Face & face = faces[i];
+            face.valid = true;
+            face.indices[0] = indices[i * 3];
+            face.indices[1] = indices[i * 3 + 1];
+            face.indices[2] = indices[i * 3 + 2];
+            face.normal = glm::vec3(planes[i]);
+        }
+    });
+    quadric.assign(cache.quadrics(), cache.quadrics() + cache.vertex_count());
+    quadric_ready = true;
+}
+
+void MeshSimple::lock(unsigned int vertex_index) {
+    vertices[vertex_index].locked = true;
+}
+
 void MeshSimple::init_quadric() {
     // compute Q0
     vector<glm::mat4> quadric_face;
@@ -68,12 +185,27 @@ void MeshSimple::init_quadric() {
 }
 
 void MeshSimple::decimate(float dec_per) {
+    decimate_until(size_t(vertices.size() * dec_per), SIZE_MAX, nullptr);
+}
+
+vector<DecimateStep> MeshSimple::decimate_profile(float dec_per) {
+    vector<DecimateStep> steps;
+    decimate_until(size_t(vertices.size() * dec_per), SIZE_MAX, &steps);
+    return steps;
+}
+
+void MeshSimple::decimate_steps(size_t count) {
+    decimate_until(0, count, nullptr);
+}
+
+void MeshSimple::decimate_until(size_t res_vert, size_t max_steps, vector<DecimateStep> * steps) {
     // initialize quadric
-    init_quadric();
+    if (!quadric_ready)
+        init_quadric();
+    quadric_ready = false;
 
     set<HalfEdge, HalfEdgeComp> cost_queue;
     vector<HalfEdge> edges;
-    vector<unsigned int> toVert[vertices.size()]; // use to update cost_queue when a vertex removed
 
     // initialize queue
     for (unsigned int i = 0; i < vertices.size(); i++) {
@@ -81,21 +213,25 @@ void MeshSimple::decimate(float dec_per) {
         HalfEdge halfEdge = selectEdge(i);
         cost_queue.insert(halfEdge);
         edges.push_back(halfEdge);
-        // update toVert
-        toVert[halfEdge.to].push_back(halfEdge.from);
     }
 
     // Main Loop
 
-    // num of vertex remains
-    int res_vert = vertices.size() * dec_per;
-
-    while(cost_queue.size() > res_vert) {
+    max_error = 0.0f;
+    size_t num_faces = 0;
+    for (const Face & face : faces)
+        num_faces += face.valid;
+    for (size_t step = 0; step < max_steps && cost_queue.size() > res_vert; step++) {
         HalfEdge e = *cost_queue.begin();
+        // only locked or isolated vertices left
+        if (e.cost == FLT_MAX) break;
+        max_error = glm::max(max_error, e.cost);
         cost_queue.erase(e);
         // delete edge and update mesh
         set<unsigned int> vert_set = connect_vert(e.from);
-        collapse(e);
+        num_faces -= collapse(e);
+        if (steps)
+            steps->push_back(DecimateStep {max_error, num_faces});
         // update quadric
         quadric[e.to] += quadric[e.to] + quadric[e.from];
         // update cost and edges
@@ -139,11 +275,12 @@ float MeshSimple::cost(unsigned int vetex_index, glm::vec3 v) {
                                                                                                 +       quad[3][3];
 }
 
-void MeshSimple::collapse(HalfEdge e) {
+unsigned int MeshSimple::collapse(HalfEdge e) {
     // simple realization
     // vertices[e.from].position = vertices[e.to].position;
 
     // delete vertex
+    unsigned int removed = 0;
     vertices[e.from].valid = false;
     for (unsigned int face_index : vertices[e.from].connected_faces) {
         for (unsigned int & vertex_index : faces[face_index].indices) {
@@ -152,9 +289,13 @@ void MeshSimple::collapse(HalfEdge e) {
                 vertices[e.to].connected_faces.push_back(face_index);
             }
             // delete face
-            else if (vertex_index == e.to) faces[face_index].valid = false;
+            else if (vertex_index == e.to && faces[face_index].valid) {
+                faces[face_index].valid = false;
+                removed++;
+            }
         }
     }
+    return removed;
 }
 
 Mesh MeshSimple::out() {
@@ -165,7 +306,9 @@ Mesh MeshSimple::out() {
     vector<unsigned int> indices;
     unsigned int count = 0;
 
-    // compute normals
+    // compute normals, from zero so a second out gives the same result
+    for (Vert & v : vertices)
+        v.normal = glm::vec3(0.0f);
     for (Face & face : faces) {
         if (face.valid) {
             glm::vec3 p0 = vertices[face.indices[0]].position;
@@ -193,12 +336,123 @@ Mesh MeshSimple::out() {
             }
         }
     }
-    return Mesh(vert, indices);
+    // normals are done above, upload the buffers as they are
+    return Mesh(MeshData {std::move(vert), std::move(indices)});
+}
+
+vector<unsigned int> MeshSimple::out_faces() {
+    vector<unsigned int> indices;
+    for (Face & face : faces) {
+        if (face.valid)
+            indices.insert(indices.end(), face.indices, face.indices + 3);
+    }
+    return indices;
+}
+
+Mesh MeshSimple::out_indexed(const OutputOptions & options) {
+    return Mesh(out_data(options));
+}
+
+QuantizedMesh MeshSimple::out_quantized(const OutputOptions & options) {
+    MeshData data = out_data(options);
+    return quantize(data.vertices, data.indices);
+}
+
+MeshletData MeshSimple::out_meshlets(const OutputOptions & options) {
+    MeshData data = out_data(options);
+    return build_meshlets(std::move(data.vertices), data.indices);
+}
+
+// indexed output followed by the optional reordering stages
+MeshData MeshSimple::out_data(const OutputOptions & options) {
+    // sized exactly up front, no reallocation while writing
+    OutputSize size = out_size(options);
+    MeshData data;
+    data.vertices.resize(size.vertex_count);
+    data.indices.resize(size.index_count);
+    out_into(data.vertices.data(), data.indices.data(), options);
+    return data;
+}
+
+OutputSize MeshSimple::out_size(const OutputOptions & options) {
+    return build_indexed(nullptr, nullptr, options);
+}
+
+void MeshSimple::out_into(Vertex * vert, unsigned int * indices, const OutputOptions & options) {
+    OutputSize size = build_indexed(vert, indices, options);
+    if (options.optimize_cache) {
+        CacheStats stats = optimize_vertex_cache(indices, size.index_count, size.vertex_count);
+        if (options.cache_stats) *options.cache_stats = stats;
+    }
+    if (options.optimize_fetch)
+        optimize_vertex_fetch(vert, size.vertex_count, sizeof(Vertex), indices, size.index_count);
+}
+
+/*
+ * Indexed output, only vertices used by a valid face are kept, numbered by first use
+ * A vertex is split into one output vertex per group of faces whose normals stay within
+ * split_angle of the first face of the group
+ * With null buffers only the sizes are computed
+ */
+OutputSize MeshSimple::build_indexed(Vertex * vert, unsigned int * indices, const OutputOptions & options) {
+    const unsigned int none = UINT_MAX;
+    bool split = options.split_angle < 180.0f;
+    float min_cos = cos(glm::radians(options.split_angle));
+
+    // output vertices of each mesh vertex, as a linked list when splitting
+    vector<unsigned int> head(vertices.size(), none), next;
+    // normal of the face that created an output vertex
+    vector<glm::vec3> seed;
+
+    OutputSize size {0, 0};
+    for (Face & face : faces) {
+        if (!face.valid) continue;
+        glm::vec3 p0 = vertices[face.indices[0]].position;
+        glm::vec3 p1 = vertices[face.indices[1]].position;
+        glm::vec3 p2 = vertices[face.indices[2]].position;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p1);
+        float len = glm::length(normal);
+        // a degenerate face joins any group
+        if (len > 0.0f) normal /= len;
+
+        for (unsigned int index : face.indices) {
+            unsigned int out_index = head[index];
+            if (split) {
+                while (out_index != none && len > 0.0f && glm::dot(seed[out_index], normal) < min_cos)
+                    out_index = next[out_index];
+            }
+            if (out_index == none) {
+                out_index = size.vertex_count++;
+                if (vert)
+                    vert[out_index] = Vertex {vertices[index].position, glm::vec3(0.0f), glm::vec2(0.0f, 0.0f)};
+                if (split) {
+                    next.push_back(head[index]);
+                    seed.push_back(normal);
+                }
+                head[index] = out_index;
+            }
+            if (vert)
+                vert[out_index].Normal += normal;
+            if (indices)
+                indices[size.index_count] = out_index;
+            size.index_count++;
+        }
+    }
+
+    if (vert) {
+        for (size_t i = 0; i < size.vertex_count; i++) {
+            float len = glm::length(vert[i].Normal);
+            if (len > 0.0f) vert[i].Normal /= len;
+        }
+    }
+    return size;
 }
 
 HalfEdge MeshSimple::selectEdge(unsigned int vertex_index) {
     float min_value = FLT_MAX;
-    unsigned int to_vert;
+    unsigned int to_vert = vertex_index;
+    if (vertices[vertex_index].locked)
+        return HalfEdge{vertex_index, to_vert, min_value};
 
     // get a vertex's all half-edges
     set<unsigned int> vert_set = connect_vert(vertex_index);
@@ -217,58 +471,114 @@ HalfEdge MeshSimple::selectEdge(unsigned int vertex_index) {
 
 void MeshSimple::cluster(int len) {
     get_boundary();
-    normalize();
-    init_quadric();
+    init_grid(len);
+    cluster_grid();
+}
+
+void MeshSimple::cluster(glm::ivec3 resolution) {
+    get_boundary();
+    init_grid(resolution);
+    cluster_grid();
+}
 
-    unsigned int clu_num = 0;
-    map<Pos, unsigned int> clu_map;
+void MeshSimple::cluster_grid() {
+    if (!quadric_ready)
+        init_quadric();
+    quadric_ready = false;
+
+    CellMap clu_map(grid.nx, grid.ny, grid.nz, cell_budget);
     vector<vector<unsigned int>> clusters;
 
-    float theta = 1.0f / (float) len;
-    for (int i = 0; i < vertices.size(); i++) {
-        Vert vert = vertices[i];
-        // computing new position
-        int x = int(vert.position.x / theta), y = int(vert.position.y / theta), z = int(vert.position.z / theta);
-        Pos pos {x, y, z};
+    for (unsigned int i = 0; i < vertices.size(); i++) {
+        unsigned int & clu = clu_map.slot(cell_of(vertices[i].position));
         // no cluster contains the vertex
-        if (clu_map.find(pos) == clu_map.end()) {
+        if (clu == CellMap::NONE) {
+            clu = clusters.size();
             clusters.emplace_back();
-            clusters[clu_num].push_back(i);
-            clu_map.insert(pair<Pos, unsigned int>{pos, clu_num});
-            clu_num++;
-        }
-        // cluster existing
-        else {
-            clusters[clu_map.find(pos)->second].push_back(i);
         }
+        clusters[clu].push_back(i);
     }
 
-    // cluster vertices
+    // cluster vertices, the representatives are solved in one batch
+    QuadricBatch batch;
+    batch.reserve(clusters.size());
+    vector<unsigned int> representatives;
     for (vector<unsigned int> & v : clusters) {
-        cluster_vertex(v);
+        if (v.size() == 1)
+            continue;
+        Cell cell = cluster_vertex(v);
+        batch.push(cell.Q, cell.sum / float(cell.count));
+        representatives.push_back(vertices.size() - 1);
     }
+    batch.solve();
+    for (unsigned int i = 0; i < representatives.size(); i++)
+        vertices[representatives[i]].position = batch.position(i);
 
     // deleting faces
     for (Face & face : faces) {
         if (face.indices[0] == face.indices[1] || face.indices[0] == face.indices[2] || face.indices[1] == face.indices[2])
             face.valid = false;
     }
+    remove_duplicate_faces();
 }
 
-void MeshSimple::normalize() {
-    float max = FLT_MIN;
-    for (float f : boundary.M) {
-        if (f < 0.0f) f = -f;
-        if (f > max) max = f;
+void MeshSimple::remove_duplicate_faces() {
+    vector<FaceKey> keys(faces.size());
+    for (unsigned int i = 0; i < faces.size(); i++) {
+        if (faces[i].valid)
+            keys[i] = FaceKey {{faces[i].indices[0], faces[i].indices[1], faces[i].indices[2]}};
+        else
+            keys[i] = FaceKey {{UINT_MAX, UINT_MAX, UINT_MAX}};
+    }
+    vector<char> duplicate = duplicate_faces(keys);
+    for (unsigned int i = 0; i < faces.size(); i++) {
+        if (duplicate[i])
+            faces[i].valid = false;
     }
+}
 
-    for (Vert & vert : vertices)
-        vert.position /= max;
+/*
+ * Fitting the grid to the bounding box
+ * len cells along the longest side, the other axes get as many cells of the same size as they need
+ */
+void MeshSimple::init_grid(int len) {
+    glm::vec3 extent(boundary.maxX - boundary.minX, boundary.maxY - boundary.minY, boundary.maxZ - boundary.minZ);
+    float longest = glm::max(extent.x, glm::max(extent.y, extent.z));
+
+    grid.origin = glm::vec3(boundary.minX, boundary.minY, boundary.minZ);
+    grid.size = glm::vec3(longest > 0.0f ? longest / (float) len : 1.0f);
+    grid.nx = glm::max(1, int(ceil(extent.x / grid.size.x)));
+    grid.ny = glm::max(1, int(ceil(extent.y / grid.size.y)));
+    grid.nz = glm::max(1, int(ceil(extent.z / grid.size.z)));
+}
+
+/*
+ * resolution cells on each axis, a flat axis gets a single cell
+ */
+void MeshSimple::init_grid(glm::ivec3 resolution) {
+    glm::vec3 extent(boundary.maxX - boundary.minX, boundary.maxY - boundary.minY, boundary.maxZ - boundary.minZ);
+    glm::ivec3 n = glm::max(resolution, glm::ivec3(1));
+
+    grid.origin = glm::vec3(boundary.minX, boundary.minY, boundary.minZ);
+    for (int axis = 0; axis < 3; axis++) {
+        if (extent[axis] <= 0.0f)
+            n[axis] = 1;
+        grid.size[axis] = extent[axis] > 0.0f ? extent[axis] / (float) n[axis] : 1.0f;
+    }
+    grid.nx = n.x;
+    grid.ny = n.y;
+    grid.nz = n.z;
+}
+
+Pos MeshSimple::cell_of(glm::vec3 position) const {
+    // vertices on the max side belong to the last cell
+    glm::vec3 p = (position - grid.origin) / grid.size;
+    return Pos {glm::min(int(p.x), grid.nx - 1), glm::min(int(p.y), grid.ny - 1), glm::min(int(p.z), grid.nz - 1)};
 }
 
 void MeshSimple::get_boundary() {
     boundary.minX = boundary.minY = boundary.minZ = FLT_MAX;
-    boundary.maxX = boundary.maxY = boundary.maxZ = FLT_MIN;
+    boundary.maxX = boundary.maxY = boundary.maxZ = -FLT_MAX;
 
     for (Vert & vert : vertices) {
         if (vert.position.x < boundary.minX) boundary.minX = vert.position.x;
@@ -280,9 +590,7 @@ void MeshSimple::get_boundary() {
     }
 }
 
-void MeshSimple::cluster_vertex(const vector<unsigned int> & cluster) {
-    if (cluster.size() == 1)
-        return;
+Cell MeshSimple::cluster_vertex(const vector<unsigned int> & cluster) {
     // simple realization
     // averaging vertices
     /*
@@ -302,12 +610,13 @@ void MeshSimple::cluster_vertex(const vector<unsigned int> & cluster) {
      */
 
     // use error quadrics
-    Vert av {true, glm::vec3(0.0f), glm::vec3(0.0f)};
-    glm::mat4 Q(0.0f);
+    Vert av {true, glm::vec3(0.0f), glm::vec3(0.0f), {}, false};
+    Cell cell {glm::mat4(0.0f), glm::vec3(0.0f), 0};
     for (unsigned int index : cluster) {
-        av.position += vertices[index].position;    // if there's no minim, which means Q can not be inverse
+        cell.sum += vertices[index].position;    // if there's no minim, which means Q can not be inverse
+        cell.count++;
         vertices[index].valid = false;
-        Q += quadric[index];
+        cell.Q += quadric[index];
         for (unsigned int face_index : vertices[index].connected_faces) {
             for (unsigned int & vert_index : faces[face_index].indices)
                 if (vert_index == index)
@@ -315,22 +624,151 @@ void MeshSimple::cluster_vertex(const vector<unsigned int> & cluster) {
             av.connected_faces.push_back(face_index);
         }
     }
-    Q[3][0] = Q[3][1] = Q[3][2] = 0.0f;
-    Q[3][3] = 1.0f;
-    // simple judgement
-    float epsilon = 1e-3, det = glm::determinant(Q);
-    if (det < 0.0) det = -det;
+    // position is solved by the caller
+    vertices.push_back(av);
+    return cell;
+}
+
+/*
+ * Clustering a ladder of resolutions len, len / 2, ..., len / 2^(levels - 1) in one pass
+ * Only the finest grid visits the vertices, every coarser level merges the 2x2x2 cells
+ * and remaps the surviving faces of the level below
+ */
+vector<MeshData> MeshSimple::cluster_levels(int len, int levels) {
+    get_boundary();
+    init_grid(len);
+    return cluster_grid_levels(levels);
+}
+
+vector<MeshData> MeshSimple::cluster_levels(glm::ivec3 resolution, int levels) {
+    get_boundary();
+    init_grid(resolution);
+    return cluster_grid_levels(levels);
+}
+
+vector<MeshData> MeshSimple::cluster_grid_levels(int levels) {
+    // vertices and faces stay as they are, so the quadrics remain valid afterwards
+    if (!quadric_ready) {
+        init_quadric();
+        quadric_ready = true;
+    }
+
+    vector<MeshData> results;
+    int nx = grid.nx, ny = grid.ny, nz = grid.nz;
+    CellMap clu_map(nx, ny, nz, cell_budget);
+    vector<Pos> cell_pos;
+    vector<Cell> cells;
+    vector<unsigned int> vert_cell(vertices.size());
+
+    // finest level, the only pass over all vertices
+    for (unsigned int i = 0; i < vertices.size(); i++) {
+        Pos pos = cell_of(vertices[i].position);
+        unsigned int & id = clu_map.slot(pos);
+        if (id == CellMap::NONE) {
+            id = cells.size();
+            cell_pos.push_back(pos);
+            cells.push_back(Cell {glm::mat4(0.0f), glm::vec3(0.0f), 0});
+        }
+        Cell & cell = cells[id];
+        cell.Q += quadric[i];
+        cell.sum += vertices[i].position;
+        cell.count++;
+        vert_cell[i] = id;
+    }
 
-    if (det < epsilon) {
-        // matrix can not be inversed
-        // average position
-        av.position /= float(cluster.size());
+    // faces as cell triples, dropping the collapsed ones
+    vector<unsigned int> cell_faces;
+    for (Face & face : faces) {
+        unsigned int c0 = vert_cell[face.indices[0]], c1 = vert_cell[face.indices[1]], c2 = vert_cell[face.indices[2]];
+        if (c0 != c1 && c0 != c2 && c1 != c2) {
+            cell_faces.push_back(c0);
+            cell_faces.push_back(c1);
+            cell_faces.push_back(c2);
+        }
     }
-    else {
-        Q = glm::inverse(Q);
-        av.position.x = Q[0][3];
-        av.position.y = Q[1][3];
-        av.position.z = Q[2][3];
+
+    for (int level = 0; level < levels; level++) {
+        remove_duplicate_faces(cell_faces);
+        results.push_back(cell_out(cells, cell_faces));
+        if (level + 1 == levels)
+            break;
+
+        // merge 2x2x2 cells, summing quadrics
+        nx = (nx + 1) / 2; ny = (ny + 1) / 2; nz = (nz + 1) / 2;
+        CellMap parent_map(nx, ny, nz, cell_budget);
+        vector<Pos> parent_pos;
+        vector<Cell> parents;
+        vector<unsigned int> parent(cells.size());
+        for (unsigned int i = 0; i < cells.size(); i++) {
+            Pos pos {cell_pos[i].x >> 1, cell_pos[i].y >> 1, cell_pos[i].z >> 1};
+            unsigned int & id = parent_map.slot(pos);
+            if (id == CellMap::NONE) {
+                id = parents.size();
+                parent_pos.push_back(pos);
+                parents.push_back(Cell {glm::mat4(0.0f), glm::vec3(0.0f), 0});
+            }
+            Cell & p = parents[id];
+            p.Q += cells[i].Q;
+            p.sum += cells[i].sum;
+            p.count += cells[i].count;
+            parent[i] = id;
+        }
+
+        // remap faces of the level below
+        vector<unsigned int> parent_faces;
+        for (unsigned int i = 0; i < cell_faces.size(); i += 3) {
+            unsigned int c0 = parent[cell_faces[i]], c1 = parent[cell_faces[i + 1]], c2 = parent[cell_faces[i + 2]];
+            if (c0 != c1 && c0 != c2 && c1 != c2) {
+                parent_faces.push_back(c0);
+                parent_faces.push_back(c1);
+                parent_faces.push_back(c2);
+            }
+        }
+
+        cell_pos.swap(parent_pos);
+        cells.swap(parents);
+        cell_faces.swap(parent_faces);
     }
-    vertices.push_back(av);
+    return results;
 }
+
+void MeshSimple::remove_duplicate_faces(vector<unsigned int> & cell_faces) {
+    vector<FaceKey> keys(cell_faces.size() / 3);
+    for (unsigned int i = 0; i < keys.size(); i++)
+        keys[i] = FaceKey {{cell_faces[i * 3], cell_faces[i * 3 + 1], cell_faces[i * 3 + 2]}};
+    vector<char> duplicate = duplicate_faces(keys);
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < keys.size(); i++) {
+        if (duplicate[i])
+            continue;
+        for (unsigned int j = 0; j < 3; j++)
+            cell_faces[count * 3 + j] = cell_faces[i * 3 + j];
+        count++;
+    }
+    cell_faces.resize(count * 3);
+}
+
+MeshData MeshSimple::cell_out(const vector<Cell> & cells, const vector<unsigned int> & cell_faces) {
+    // same layout as out(), three vertices per face
+    // as in cluster, a cell holding a single vertex keeps its position, the others are solved
+    QuadricBatch batch;
+    batch.reserve(cells.size());
+    vector<unsigned int> solved(cells.size(), UINT_MAX);
+    for (unsigned int i = 0; i < cells.size(); i++)
+        if (cells[i].count > 1) {
+            solved[i] = (unsigned int)batch.size();
+            batch.push(cells[i].Q, cells[i].sum / float(cells[i].count));
+        }
+    batch.solve();
+
+    MeshData data;
+    for (unsigned int i = 0; i < cell_faces.size(); i++) {
+        unsigned int c = cell_faces[i];
+        glm::vec3 position = solved[c] == UINT_MAX ? cells[c].sum : batch.position(solved[c]);
+        Vertex vertex { position, glm::vec3(0.0f), glm::vec2(0.0f, 0.0f)};
+        data.vertices.push_back(vertex);
+        data.indices.push_back(i);
+    }
+    compute_normals(data);
+    return data;
+}
\ No newline at end of file
@@ -2,11 +2,17 @@
 #define SIMPLIFICATION_SIMPLIFICATION_H
 
 #include "model/mesh.h"
+#include "optimizer.h"
+#include "quantize.h"
+#include "meshlet.h"
+#include "meshCache.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <stb_image.h>
 
 #include <set>
+#include <map>
+#include <climits>
 
 struct Vert {
     // deleted
@@ -17,6 +23,8 @@ struct Vert {
     glm::vec3 normal;
     // connected faces, initialize after
     vector<unsigned int> connected_faces;
+    // never collapsed by decimate
+    bool locked = false;
 };
 
 struct Face {
@@ -53,6 +61,41 @@ struct Pos {
     }
 };
 
+// grid cell slots, a dense array when it fits the memory budget, otherwise a map
+class CellMap {
+public:
+    static const unsigned int NONE = UINT_MAX;
+    // bytes the dense array may take, 4 per cell
+    static const size_t DEFAULT_BUDGET = size_t(64) << 20;
+
+    CellMap(int nx, int ny, int nz, size_t budget = DEFAULT_BUDGET);
+    // slot holding the cell id at pos, NONE if the cell is new
+    unsigned int & slot(const Pos & pos);
+
+private:
+    int nx, ny;
+    vector<unsigned int> dense;
+    map<Pos, unsigned int> sparse;
+};
+
+struct Grid {
+    // min corner of the boundary
+    glm::vec3 origin;
+    // edge lengths of a cell, per axis
+    glm::vec3 size;
+    // cells on each axis
+    int nx, ny, nz;
+};
+
+struct Cell {
+    // summed quadric of the vertices inside
+    glm::mat4 Q;
+    // summed position, used when Q can not be inversed
+    glm::vec3 sum;
+    // number of vertices inside
+    unsigned int count;
+};
+
 struct HalfEdgeComp {
     // building priority queue
     bool operator() (const HalfEdge & e1, const HalfEdge & e2) {
@@ -62,12 +105,61 @@ struct HalfEdgeComp {
     }
 };
 
+struct OutputOptions {
+    // split a vertex where the normals of its faces differ by more than this angle (degrees), 180 never splits
+    float split_angle = 180.0f;
+    // reorder triangles for the post-transform vertex cache
+    bool optimize_cache = false;
+    // ACMR before and after the reordering, when not null
+    CacheStats * cache_stats = nullptr;
+    // renumber vertices in first-use order of the final index buffer
+    bool optimize_fetch = false;
+};
+
+struct DecimateStep {
+    // largest cost collapsed so far, never decreasing along a profile
+    float error;
+    // valid faces left after the collapse
+    size_t faces;
+};
+
+struct OutputSize {
+    size_t vertex_count, index_count;
+};
+
 class MeshSimple {
 public:
-    MeshSimple(const Mesh & mesh);
+    MeshSimple(const MeshData & mesh);
+    // from the precomputed state of a cache, the first decimate skips computing the quadrics
+    MeshSimple(const MeshCache & cache);
+    void lock(unsigned int vertex_index);
     void decimate(float dec_per);
+    // decimate recording every collapse, the same collapses happen again for the same mesh
+    vector<DecimateStep> decimate_profile(float dec_per);
+    // the first count collapses decimate would make, so a prefix of a profile can be replayed
+    void decimate_steps(size_t count);
+    // largest cost collapsed by the last decimate
+    float error() const { return max_error; }
+    // cubic cells, len of them along the longest side of the bounding box
     void cluster(int len);
+    // resolution.x * resolution.y * resolution.z cells spanning the bounding box
+    void cluster(glm::ivec3 resolution);
+    vector<MeshData> cluster_levels(int len, int levels);
+    vector<MeshData> cluster_levels(glm::ivec3 resolution, int levels);
+    // memory the clustering grid may take as a dense array, larger grids use a map
+    void set_cell_budget(size_t bytes) { cell_budget = bytes; }
     Mesh out();
+    // indexed output on the CPU only, see out_indexed
+    MeshData out_data(const OutputOptions & options = OutputOptions());
+    // exact size of the indexed output, for buffers handed to out_into
+    OutputSize out_size(const OutputOptions & options = OutputOptions());
+    // writes the indexed output straight into caller buffers of out_size, with the same options
+    void out_into(Vertex * vert, unsigned int * indices, const OutputOptions & options = OutputOptions());
+    // indices of the valid faces, in the input vertex numbering
+    vector<unsigned int> out_faces();
+    Mesh out_indexed(const OutputOptions & options = OutputOptions());
+    QuantizedMesh out_quantized(const OutputOptions & options = OutputOptions());
+    MeshletData out_meshlets(const OutputOptions & options = OutputOptions());
 
 
 private:
@@ -75,14 +167,29 @@ private:
     vector<Face> faces;
     vector<glm::mat4> quadric;
     Boundary boundary;
+    Grid grid;
+    float max_error = 0.0f;
+    // quadric already holds the quadrics of the current faces
+    bool quadric_ready = false;
+    size_t cell_budget = CellMap::DEFAULT_BUDGET;
 
     void get_boundary();
-    void normalize();
-    void cluster_vertex(const vector<unsigned int> & cluster);
+    void init_grid(int len);
+    void init_grid(glm::ivec3 resolution);
+    void cluster_grid();
+    vector<MeshData> cluster_grid_levels(int levels);
+    Pos cell_of(glm::vec3 position) const;
+    Cell cluster_vertex(const vector<unsigned int> & cluster);
+    void remove_duplicate_faces();
+    void remove_duplicate_faces(vector<unsigned int> & cell_faces);
+    OutputSize build_indexed(Vertex * vert, unsigned int * indices, const OutputOptions & options);
+    MeshData cell_out(const vector<Cell> & cells, const vector<unsigned int> & cell_faces);
     void init_quadric();
     float cost(unsigned int vetex_index, glm::vec3 v);
     set<unsigned int> connect_vert(unsigned int vert_index);
-    void collapse(HalfEdge e);
+    void decimate_until(size_t res_vert, size_t max_steps, vector<DecimateStep> * steps);
+    // returns the number of faces removed
+    unsigned int collapse(HalfEdge e);
     HalfEdge selectEdge(unsigned int vertex_index);
 };
 
@@ -0,0 +1,294 @@
+#include "streaming.h"
+#include "quadricSolve.h"
+#include "model/lineReader.h"
+#include "model/objLoader.h"
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <unordered_set>
+
+struct StreamCell {
+    // summed plane quadrics of the faces touching the cell
+    glm::mat4 Q;
+    // summed position of the vertices inside
+    glm::vec3 sum;
+    unsigned int count;
+};
+
+// worst case bytes per grid cell: slot, cell, batch entry, output number and position
+static const size_t STREAM_CELL_BYTES = sizeof(unsigned int) + sizeof(StreamCell) + 15 * sizeof(float) + 2 * sizeof(unsigned int) +
+    sizeof(glm::vec3);
+static const size_t STREAM_BUFFER_BYTES = 1 << 23;
+// vertices per block of the spill cache
+static const size_t STREAM_SPILL_BLOCK = 4096;
+
+struct StreamTriangle {
+    unsigned int cells[3];
+    bool operator==(const StreamTriangle & t) const {
+        return cells[0] == t.cells[0] && cells[1] == t.cells[1] && cells[2] == t.cells[2];
+    }
+};
+
+struct StreamTriangleHash {
+    size_t operator()(const StreamTriangle & t) const {
+        return ((size_t) t.cells[0] * 73856093u) ^ ((size_t) t.cells[1] * 19349663u) ^ ((size_t) t.cells[2] * 83492791u);
+    }
+};
+
+/*
+ * Spilled positions read back through a direct mapped cache of fixed blocks,
+ * its memory is part of the budget however the faces jump around the file
+ */
+class SpillCache {
+public:
+    SpillCache(int fd, size_t num_vertices, size_t bytes) : fd(fd), num_vertices(num_vertices) {
+        size_t num_blocks = (num_vertices + STREAM_SPILL_BLOCK - 1) / STREAM_SPILL_BLOCK;
+        size_t slots = max(size_t(1), min(num_blocks, bytes / (STREAM_SPILL_BLOCK * sizeof(glm::vec3))));
+        tags.assign(slots, SIZE_MAX);
+        blocks.resize(slots * STREAM_SPILL_BLOCK);
+    }
+
+    bool valid() const { return !failed; }
+
+    glm::vec3 operator[](size_t i) {
+        size_t block = i / STREAM_SPILL_BLOCK, slot = block % tags.size();
+        glm::vec3 * data = &blocks[slot * STREAM_SPILL_BLOCK];
+        if (tags[slot] != block) {
+            tags[slot] = block;
+            size_t first = block * STREAM_SPILL_BLOCK;
+            size_t size = min(STREAM_SPILL_BLOCK, num_vertices - first) * sizeof(glm::vec3), done = 0;
+            while (done < size) {
+                ssize_t n = pread(fd, (char *) data + done, size - done, (off_t) (first * sizeof(glm::vec3) + done));
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) {
+                    failed = true;
+                    break;
+                }
+                done += n;
+            }
+        }
+        return data[i % STREAM_SPILL_BLOCK];
+    }
+
+private:
+    int fd;
+    size_t num_vertices;
+    vector<size_t> tags;
+    vector<glm::vec3> blocks;
+    bool failed = false;
+};
+
+// calls v(position) for every v line and f(a, b, c) for every fanned triangle, indices resolved to 0 based
+template <typename V, typename F>
+static void stream_obj_lines(const char * p, const char * end, size_t & vertex_count, V on_vertex, F on_triangle) {
+    while (p < end) {
+        const char * line_end = (const char *) memchr(p, '\n', end - p);
+        if (!line_end) line_end = end;
+        p = skip_space(p, line_end);
+        if (line_end - p > 1 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            glm::vec3 position(0.0f);
+            const char * q = p + 2;
+            for (int i = 0; i < 3; i++)
+                q = parse_float(skip_space(q, line_end), line_end, position[i]);
+            on_vertex(position);
+            vertex_count++;
+        }
+        else if (line_end - p > 1 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            long long first = -1, previous = -1;
+            int count = 0;
+            const char * q = skip_space(p + 2, line_end);
+            while (q < line_end) {
+                int index;
+                unsigned char relative = 0;
+                const char * next = parse_obj_index(q, line_end, vertex_count, OBJ_RELATIVE_POSITION, index, relative);
+                if (index == OBJ_NO_INDEX) break;
+                while (next < line_end && *next != ' ' && *next != '\t' && *next != '\r') next++;
+                long long corner = index;
+                if (count == 0) first = corner;
+                else if (count >= 2) on_triangle(first, previous, corner);
+                previous = corner;
+                count++;
+                q = skip_space(next, line_end);
+            }
+        }
+        p = line_end + 1;
+    }
+}
+
+bool simplify_obj_stream(const char * input, const char * output, const StreamOptions & options, StreamStats * stats) {
+    LineReader reader(input, STREAM_BUFFER_BYTES);
+    if (!reader.valid()) {
+        cout << "ERROR::STREAMING::FILE_NOT_SUCCESFULLY_READ" << endl;
+        return false;
+    }
+    FILE * spill = tmpfile();
+    if (!spill) {
+        cout << "ERROR::STREAMING::NO_TEMPORARY_FILE" << endl;
+        return false;
+    }
+
+    // pass 1, bounding box and positions to the spill file
+    glm::vec3 min_corner(FLT_MAX), max_corner(-FLT_MAX);
+    size_t num_vertices = 0, num_input_triangles = 0;
+    const char * begin, * end;
+    bool ok = true;
+    while (reader.next(begin, end)) {
+        size_t before = num_vertices;
+        vector<glm::vec3> block;
+        stream_obj_lines(begin, end, num_vertices, [&](const glm::vec3 & p) {
+            min_corner = glm::min(min_corner, p);
+            max_corner = glm::max(max_corner, p);
+            block.push_back(p);
+        }, [&](long long, long long, long long) { num_input_triangles++; });
+        ok = ok && fwrite(block.data(), sizeof(glm::vec3), num_vertices - before, spill) == num_vertices - before;
+    }
+    ok = ok && reader.valid() && fflush(spill) == 0;
+    if (!ok || num_vertices == 0) {
+        cout << "ERROR::STREAMING::" << (ok ? "NO_VERTICES" : "FILE_NOT_SUCCESFULLY_READ") << endl;
+        fclose(spill);
+        return false;
+    }
+    // a quarter of the budget caches spilled positions, the grid gets what is left after the read buffer
+    size_t spill_bytes = min(options.memory_budget / 4, num_vertices * sizeof(glm::vec3));
+    SpillCache positions(fileno(spill), num_vertices, spill_bytes);
+    size_t fixed_bytes = 2 * STREAM_BUFFER_BYTES + spill_bytes;
+
+    // grid as in MeshSimple::init_grid, as fine as the budget allows
+    glm::vec3 extent = max_corner - min_corner;
+    float longest = glm::max(extent.x, glm::max(extent.y, extent.z));
+    size_t cell_budget = options.memory_budget > fixed_bytes ? options.memory_budget - fixed_bytes : 0;
+    int len = max(1, options.grid_len), nx, ny, nz;
+    float cell_size;
+    while (true) {
+        cell_size = longest > 0.0f ? longest / (float) len : 1.0f;
+        nx = max(1, int(ceil(extent.x / cell_size)));
+        ny = max(1, int(ceil(extent.y / cell_size)));
+        nz = max(1, int(ceil(extent.z / cell_size)));
+        if (len == 1 || (size_t) nx * ny * nz * STREAM_CELL_BYTES <= cell_budget) break;
+        len--;
+    }
+    auto cell_of = [&](const glm::vec3 & position) {
+        glm::vec3 p = (position - min_corner) / cell_size;
+        int x = glm::clamp(int(p.x), 0, nx - 1), y = glm::clamp(int(p.y), 0, ny - 1), z = glm::clamp(int(p.z), 0, nz - 1);
+        return ((size_t) z * ny + y) * nx + x;
+    };
+    vector<unsigned int> slots((size_t) nx * ny * nz, UINT_MAX);
+    vector<StreamCell> cells;
+    auto cell_id = [&](const glm::vec3 & position) {
+        unsigned int & slot = slots[cell_of(position)];
+        if (slot == UINT_MAX) {
+            slot = (unsigned int) cells.size();
+            cells.push_back(StreamCell {glm::mat4(0.0f), glm::vec3(0.0f), 0});
+        }
+        return slot;
+    };
+
+    // pass 2, position sums and face quadrics per cell, triangles spanning three cells
+    vector<StreamTriangle> triangles;
+    unordered_set<StreamTriangle, StreamTriangleHash> seen;
+    size_t vertex_count = 0, dropped = 0;
+    reader.rewind();
+    while (reader.next(begin, end)) {
+        stream_obj_lines(begin, end, vertex_count, [&](const glm::vec3 & p) {
+            StreamCell & cell = cells[cell_id(p)];
+            cell.sum += p;
+            cell.count++;
+        }, [&](long long a, long long b, long long c) {
+            if (a < 0 || b < 0 || c < 0 || a >= (long long) num_vertices || b >= (long long) num_vertices ||
+                c >= (long long) num_vertices) {
+                dropped++;
+                return;
+            }
+            glm::vec3 p0 = positions[a], p1 = positions[b], p2 = positions[c];
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p1);
+            float length = glm::length(normal);
+            // pass 1 knows every position, so a vertex defined after the face gets its cell here
+            unsigned int ids[3] = {cell_id(p0), cell_id(p1), cell_id(p2)};
+            if (length > 0.0f) {
+                // same plane quadric as MeshSimple::init_quadric
+                normal /= length;
+                glm::vec4 plane(normal, -glm::dot(normal, p0));
+                glm::mat4 Q = glm::outerProduct(plane, plane);
+                for (unsigned int id : ids)
+                    cells[id].Q += Q;
+            }
+            if (ids[0] == ids[1] || ids[1] == ids[2] || ids[0] == ids[2])
+                return;
+            // sorted key as in duplicate_faces, so either winding is a duplicate, the first one is kept
+            StreamTriangle key {{ids[0], ids[1], ids[2]}};
+            sort(key.cells, key.cells + 3);
+            if (seen.insert(key).second)
+                triangles.push_back(StreamTriangle {{ids[0], ids[1], ids[2]}});
+        });
+    }
+    ok = reader.valid() && positions.valid();
+    fclose(spill);
+    if (!ok) {
+        cout << "ERROR::STREAMING::FILE_NOT_SUCCESFULLY_READ" << endl;
+        return false;
+    }
+    if (dropped)
+        cout << "ERROR::STREAMING::INDEX_OUT_OF_RANGE" << endl;
+    unordered_set<StreamTriangle, StreamTriangleHash>().swap(seen);
+    vector<unsigned int>().swap(slots);
+
+    // representatives of the cells the output uses, numbered in first use order
+    // as in MeshSimple::cluster, a cell holding a single vertex keeps its position, the others are solved
+    vector<unsigned int> number(cells.size(), UINT_MAX);
+    vector<glm::vec3> kept;
+    vector<unsigned int> solved;
+    QuadricBatch batch;
+    for (StreamTriangle & t : triangles)
+        for (unsigned int & id : t.cells) {
+            if (number[id] == UINT_MAX) {
+                number[id] = (unsigned int) kept.size();
+                kept.push_back(cells[id].sum);
+                if (cells[id].count > 1) {
+                    solved.push_back(number[id]);
+                    batch.push(cells[id].Q, cells[id].sum / float(cells[id].count));
+                }
+            }
+            id = number[id];
+        }
+    vector<StreamCell>().swap(cells);
+    batch.solve();
+    for (size_t i = 0; i < solved.size(); i++)
+        kept[solved[i]] = batch.position(i);
+
+    int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        cout << "ERROR::STREAMING::FILE_NOT_SUCCESFULLY_WRITTEN" << endl;
+        return false;
+    }
+    auto vector_line = [&](char * out, size_t i) {
+        glm::vec3 p = kept[i];
+        *out++ = 'v';
+        for (int k = 0; k < 3; k++) {
+            *out++ = ' ';
+            out = format_float(out, p[k]);
+        }
+        *out++ = '\n';
+        return out;
+    };
+    ok = write_obj_lines(fd, kept.size(), 64, vector_line);
+    ok = ok && write_obj_lines(fd, triangles.size(), 40, [&](char * out, size_t f) {
+        *out++ = 'f';
+        for (unsigned int id : triangles[f].cells) {
+            *out++ = ' ';
+            out = format_uint(out, id + 1);
+        }
+        *out++ = '\n';
+        return out;
+    });
+    ok = close(fd) == 0 && ok;
+    if (!ok)
+        cout << "ERROR::STREAMING::FILE_NOT_SUCCESFULLY_WRITTEN" << endl;
+
+    if (stats)
+        *stats = StreamStats {num_vertices, num_input_triangles, kept.size(), triangles.size(), len};
+    return ok;
+}
@@ -0,0 +1,31 @@
+#ifndef SIMPLIFICATION_STREAMING_H
+#define SIMPLIFICATION_STREAMING_H
+
+#include <cstddef>
+
+struct StreamOptions {
+    // working memory in bytes for the read buffer and the cell grid, independent of the input size
+    size_t memory_budget = size_t(256) << 20;
+    // cells along the longest axis, lowered until the grid fits the budget
+    int grid_len = 256;
+};
+
+struct StreamStats {
+    size_t input_vertices, input_triangles;
+    size_t output_vertices, output_triangles;
+    // grid resolution actually used
+    int grid_len;
+};
+
+/*
+ * Out-of-core vertex clustering from one OBJ file to another (Lindstrom 2000)
+ * The input is read twice through a fixed buffer, first for the bounding box, then for the cell position sums
+ * and the faces, whose plane quadrics go to the cells of their corners. Triangles spanning three cells are kept.
+ * Vertex positions for the face pass are spilled to an unlinked temporary file and read back through
+ * a block cache that takes a quarter of the budget, so faces may also reference vertices defined after them.
+ * Only the kept triangles grow past the budget, and they scale with the grid rather than the input
+ */
+bool simplify_obj_stream(const char * input, const char * output, const StreamOptions & options = StreamOptions(),
+                         StreamStats * stats = nullptr);
+
+#endif //SIMPLIFICATION_STREAMING_H
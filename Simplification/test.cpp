@@ -94,8 +94,8 @@ int main()
     // -----------
     // Model ourModel("../resources/objects/AngelLucy/Alucy.obj");
     // Mesh mesh = loadOBJ("../resources/objects/cube/pCube.obj");
-    Mesh mesh = loadOBJ("../resources/objects/AngelLucy/Alucy.obj", 0.01f),
-        renderMesh = loadOBJ("../resources/objects/AngelLucy/Alucy.obj", 0.01f);
+    Mesh mesh(loadOBJ("../resources/objects/AngelLucy/Alucy.obj", 0.01f)),
+        renderMesh(loadOBJ("../resources/objects/AngelLucy/Alucy.obj", 0.01f));
     // Mesh mesh = loadOBJ("/Users/fengyandeng/Desktop/Object/sphere0.obj"),
     //     renderMesh = loadOBJ("/Users/fengyandeng/Desktop/Object/sphere0.obj");
     mp = & mesh;
@@ -0,0 +1,77 @@
+#include "weld.h"
+#include <cmath>
+#include <climits>
+
+struct WeldCell {
+    long long x, y, z;
+};
+
+static WeldCell weld_cell(const glm::vec3 & p, float cell_size) {
+    return {(long long) floor((double) p.x / cell_size), (long long) floor((double) p.y / cell_size),
+            (long long) floor((double) p.z / cell_size)};
+}
+
+static size_t weld_hash(long long x, long long y, long long z, size_t mask) {
+    unsigned long long h = (unsigned long long) x * 0x9E3779B97F4A7C15ull;
+    h ^= (unsigned long long) y * 0xC2B2AE3D27D4EB4Full;
+    h ^= (unsigned long long) z * 0x165667B19E3779F9ull;
+    return (size_t) (h ^ (h >> 31)) & mask;
+}
+
+size_t weld(MeshData & mesh, float epsilon) {
+    size_t num_vertices = mesh.vertices.size();
+    if (num_vertices == 0)
+        return 0;
+    float cell_size = epsilon > 0.0f ? epsilon : 1.0f;
+    float epsilon2 = epsilon * epsilon;
+
+    size_t capacity = 1;
+    while (capacity < num_vertices * 2) capacity <<= 1;
+    // chains of kept vertices per bucket, heads and next hold new vertex indices
+    vector<unsigned int> heads(capacity, UINT_MAX), next;
+    vector<unsigned int> remap(num_vertices);
+    vector<Vertex> kept;
+    next.reserve(num_vertices);
+    kept.reserve(num_vertices);
+
+    for (size_t v = 0; v < num_vertices; v++) {
+        const glm::vec3 & p = mesh.vertices[v].Position;
+        WeldCell c = weld_cell(p, cell_size);
+        unsigned int found = UINT_MAX;
+        for (int dx = -1; dx <= 1; dx++)
+            for (int dy = -1; dy <= 1; dy++)
+                for (int dz = -1; dz <= 1; dz++) {
+                    size_t bucket = weld_hash(c.x + dx, c.y + dy, c.z + dz, capacity - 1);
+                    for (unsigned int k = heads[bucket]; k != UINT_MAX; k = next[k]) {
+                        glm::vec3 d = kept[k].Position - p;
+                        if (k < found && glm::dot(d, d) <= epsilon2)
+                            found = k;
+                    }
+                }
+        if (found == UINT_MAX) {
+            found = (unsigned int) kept.size();
+            kept.push_back(mesh.vertices[v]);
+            size_t bucket = weld_hash(c.x, c.y, c.z, capacity - 1);
+            next.push_back(heads[bucket]);
+            heads[bucket] = found;
+        }
+        remap[v] = found;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        unsigned int a = remap[mesh.indices[i]], b = remap[mesh.indices[i + 1]], c = remap[mesh.indices[i + 2]];
+        if (a == b || b == c || a == c)
+            continue;
+        mesh.indices[count++] = a;
+        mesh.indices[count++] = b;
+        mesh.indices[count++] = c;
+    }
+    mesh.indices.resize(count);
+
+    size_t removed = num_vertices - kept.size();
+    mesh.vertices.swap(kept);
+    if (removed > 0)
+        compute_normals(mesh);
+    return removed;
+}
@@ -0,0 +1,15 @@
+#ifndef SIMPLIFICATION_WELD_H
+#define SIMPLIFICATION_WELD_H
+
+#include "model/meshData.h"
+
+/*
+ * Merges vertices closer than epsilon into the earliest of them, drops the triangles that
+ * collapse and recomputes normals. Vertices are hashed into epsilon sized grid cells so only
+ * the 27 surrounding cells are searched, linear in the vertex count.
+ * Run before MeshSimple so seams split by the exporter become connected.
+ * Returns the number of vertices removed
+ */
+size_t weld(MeshData & mesh, float epsilon);
+
+#endif //SIMPLIFICATION_WELD_H